@@ -0,0 +1,13 @@
+#!/bin/bash
+# Build and run the kernel microbenchmarks in bench/.
+# Pass a filter string (e.g. ./bench.sh triangle) to only run matching benchmarks.
+set -eu
+
+CXX=${CXX:-g++}
+
+echo >&2 "Compiling..."
+$CXX --std=c++11 -O2 -DNDEBUG -DIMGUI_DISABLE_OBSOLETE_FUNCTIONS \
+	-I src -isystem third_party \
+	bench/bench_kernels.cpp -o bench_kernels.bin
+
+./bench_kernels.bin "$@"
@@ -0,0 +1,360 @@
+// Microbenchmarks of the individual painting kernels of imgui_sw, without the noise of a full scene.
+// Build and run with ./bench.sh [filter], or:
+//   g++ --std=c++11 -O2 -DNDEBUG -I src -isystem third_party bench/bench_kernels.cpp -o bench_kernels.bin
+//   ./bench_kernels.bin [filter]
+// Only benchmarks whose kernel or parameters contain the filter string are run.
+//
+// Each benchmark paints a grid of identical primitives over a 1024x1024 target,
+// so the per-primitive setup cost is included, just as in a real frame.
+// The target is reset between runs, and the fastest of the runs is reported:
+//   ns/px      nanoseconds per painted pixel
+//   cycles/px  time stamp counter ticks per painted pixel (x86 only)
+//   Mpx/s      million painted pixels per second
+//
+// The path column names the code path taken inside the kernel (e.g. blit vs sampled glyphs),
+// so a new path (such as a SIMD version of a kernel) should get its own name here.
+
+// Include the implementation directly to get at the kernels in its anonymous namespace:
+#include "imgui_sw.cpp"
+
+#include <imgui/imgui.cpp>
+#include <imgui/imgui_demo.cpp>
+#include <imgui/imgui_draw.cpp>
+
+#include <cstdarg>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+	#include <x86intrin.h>
+	#define BENCH_HAS_TSC 1
+#else
+	#define BENCH_HAS_TSC 0
+#endif
+
+namespace {
+
+using namespace imgui_sw;
+
+const int kCanvasSize = 1024;
+const int kNumRuns = 9;
+const int kGap = 1; // Pixels between the primitives of a grid.
+
+const char* s_filter = nullptr;
+volatile uint32_t s_sink; // Keeps the compiler from optimizing away results nobody reads.
+
+uint64_t read_tsc()
+{
+#if BENCH_HAS_TSC
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+bool matches_filter(const std::string& kernel, const std::string& params)
+{
+	return !s_filter || kernel.find(s_filter) != std::string::npos || params.find(s_filter) != std::string::npos;
+}
+
+// ----------------------------------------------------------------------------
+
+enum class Background { Flat, Noise };
+
+struct Canvas
+{
+	std::vector<uint32_t> pixels;
+	std::vector<uint32_t> background;
+
+	explicit Canvas(Background background_kind)
+		: pixels(kCanvasSize * kCanvasSize)
+		, background(kCanvasSize * kCanvasSize, IM_COL32(40, 40, 50, 255))
+	{
+		if (background_kind == Background::Noise) {
+			std::mt19937 rng(1234);
+			for (uint32_t& pixel : background) {
+				pixel = rng() | IM_COL32(0, 0, 0, 255);
+			}
+		}
+	}
+
+	PaintTarget target(float scale) const
+	{
+		const int width_tiles = kCanvasSize >> kTileShift;
+		return PaintTarget{const_cast<uint32_t*>(pixels.data()), kCanvasSize, kCanvasSize, kCanvasSize, ImVec2(scale, scale),
+		                   width_tiles, 0, kCanvasSize, nullptr, nullptr, false};
+	}
+
+	void reset() { pixels = background; }
+};
+
+/// paint() paints the canvas once and returns the number of pixels painted.
+template<typename PaintFn>
+void run(const std::string& kernel, const std::string& path, const std::string& params, Canvas& canvas, PaintFn paint)
+{
+	if (!matches_filter(kernel, path + " " + params)) { return; }
+
+	double best_ns = std::numeric_limits<double>::infinity();
+	double best_ticks = std::numeric_limits<double>::infinity();
+	double num_pixels = 0;
+
+	for (int i = 0; i < kNumRuns; ++i) {
+		canvas.reset();
+		const auto start_time = std::chrono::steady_clock::now();
+		const uint64_t start_ticks = read_tsc();
+		num_pixels = paint();
+		const uint64_t end_ticks = read_tsc();
+		const auto end_time = std::chrono::steady_clock::now();
+
+		best_ns = std::min(best_ns, std::chrono::duration<double, std::nano>(end_time - start_time).count());
+		best_ticks = std::min(best_ticks, static_cast<double>(end_ticks - start_ticks));
+	}
+	s_sink = canvas.pixels[kCanvasSize * kCanvasSize / 2 + kCanvasSize / 2];
+
+	if (num_pixels <= 0) { return; }
+	const double ns_per_pixel = best_ns / num_pixels;
+	if (BENCH_HAS_TSC) {
+		printf("%-24s %-10s %-42s %9.3f %9.2f %9.1f\n", kernel.c_str(), path.c_str(), params.c_str(),
+		       ns_per_pixel, best_ticks / num_pixels, 1e3 / ns_per_pixel);
+	} else {
+		printf("%-24s %-10s %-42s %9.3f %9s %9.1f\n", kernel.c_str(), path.c_str(), params.c_str(),
+		       ns_per_pixel, "-", 1e3 / ns_per_pixel);
+	}
+}
+
+/// Calls fn(x, y) with the top-left corner (in pixels) of each cell of a grid of size x size cells.
+template<typename Fn>
+int for_each_cell(int size, int offset, Fn fn)
+{
+	int count = 0;
+	for (int y = offset; y + size <= kCanvasSize; y += size + kGap) {
+		for (int x = offset; x + size <= kCanvasSize; x += size + kGap) {
+			fn(x, y);
+			count += 1;
+		}
+	}
+	return count;
+}
+
+std::string format(const char* fmt, ...)
+{
+	char buffer[256];
+	va_list args;
+	va_start(args, fmt);
+	vsnprintf(buffer, sizeof(buffer), fmt, args);
+	va_end(args);
+	return buffer;
+}
+
+const char* background_name(Background background) { return background == Background::Flat ? "flat" : "noise"; }
+
+// ----------------------------------------------------------------------------
+// A font-like texture: 16x16 cells, each with an anti-aliased disc in it.
+// Like the real font texture it is mostly 0 and 255, with some values in between.
+
+struct FontTexture
+{
+	std::vector<uint8_t> pixels;
+	Texture              texture;
+
+	FontTexture() : pixels(256 * 256)
+	{
+		for (int y = 0; y < 256; ++y) {
+			for (int x = 0; x < 256; ++x) {
+				const float dx = (x & 15) + 0.5f - 8.0f;
+				const float dy = (y & 15) + 0.5f - 8.0f;
+				const float coverage = 6.0f - std::sqrt(dx * dx + dy * dy);
+				pixels[y * 256 + x] = static_cast<uint8_t>(std::max(0.0f, std::min(coverage, 1.0f)) * 255.0f);
+			}
+		}
+		texture = Texture{pixels.data(), 256, 256};
+	}
+};
+
+ImDrawVert make_vert(float x, float y, float u, float v, ImU32 col)
+{
+	ImDrawVert vert;
+	vert.pos = ImVec2(x, y);
+	vert.uv = ImVec2(u, v);
+	vert.col = col;
+	return vert;
+}
+
+// ----------------------------------------------------------------------------
+
+void bench_blend()
+{
+	for (const int alpha : {255, 128, 0}) {
+		Canvas canvas(Background::Noise);
+		const ColorInt color(IM_COL32(200, 100, 50, alpha));
+		run("blend", "scalar", format("alpha=%d", alpha), canvas, [&]() {
+			for (uint32_t& pixel : canvas.pixels) {
+				pixel = blend(ColorInt(pixel), color).toUint32();
+			}
+			return static_cast<double>(canvas.pixels.size());
+		});
+	}
+}
+
+void bench_sample_texture(const FontTexture& font)
+{
+	for (const float texels_per_pixel : {1.0f, 0.5f, 2.0f}) {
+		Canvas canvas(Background::Flat);
+		run("sample_texture", "nearest", format("texels/px=%.1f", texels_per_pixel), canvas, [&]() {
+			const float du = texels_per_pixel / font.texture.width;
+			const float dv = texels_per_pixel / font.texture.height;
+			uint32_t sum = 0;
+			for (int y = 0; y < kCanvasSize; ++y) {
+				ImVec2 uv(0.0f, std::fmod(y * dv, 1.0f));
+				for (int x = 0; x < kCanvasSize; ++x, uv.x += du) {
+					sum += sample_texture(font.texture, uv);
+				}
+			}
+			s_sink = sum;
+			return static_cast<double>(kCanvasSize) * kCanvasSize;
+		});
+	}
+}
+
+void bench_uniform_rectangle()
+{
+	for (const Background background : {Background::Flat, Background::Noise}) {
+		for (const int alpha : {255, 128}) {
+			for (const int size : {4, 16, 64, 256}) {
+				for (const int offset : {0, 7}) {
+					Canvas canvas(background);
+					const PaintTarget target = canvas.target(1.0f);
+					const ColorInt color(IM_COL32(200, 100, 50, alpha));
+					const std::string params = format("%s alpha=%d size=%d offset=%d",
+						background_name(background), alpha, size, offset);
+					run("uniform_rectangle", "scalar", params, canvas, [&]() {
+						const int count = for_each_cell(size, offset, [&](int x, int y) {
+							paint_uniform_rectangle(target, ImVec2(x, y), ImVec2(x + size, y + size), color, nullptr);
+						});
+						return static_cast<double>(count) * size * size;
+					});
+				}
+			}
+		}
+	}
+}
+
+void bench_textured_rectangle(const FontTexture& font)
+{
+	const ImVec4 clip_rect(0, 0, kCanvasSize, kCanvasSize);
+
+	// Without the atlas for the scale, glyphs are sampled from the original texture.
+	struct Scaling
+	{
+		float scale;
+		bool  scaled_atlas;
+	};
+	const Scaling scalings[] = {{1.0f, true}, {1.5f, true}, {1.5f, false}, {2.0f, true}, {2.0f, false}};
+
+	for (const Scaling& scaling : scalings) {
+		const float scale = scaling.scale;
+		for (const int alpha : {255, 128}) {
+			for (const int glyph_size : {8, 16}) {
+				Canvas canvas(Background::Flat);
+				const PaintTarget target = canvas.target(scale);
+				const Texture& texture = scaling.scaled_atlas ? texture_at_scale(font.texture, target.scale) : font.texture;
+				const ImU32 col = IM_COL32(255, 255, 255, alpha);
+				const int pixel_size = static_cast<int>(glyph_size * scale);
+
+				// Glyph (min, max) corners in points, cycling through the texture:
+				auto glyph_corners = [&](int x, int y, ImDrawVert* out_min, ImDrawVert* out_max) {
+					const float u = ((x / (pixel_size + kGap)) % (256 / glyph_size)) * glyph_size / 256.0f;
+					const float v = ((y / (pixel_size + kGap)) % (256 / glyph_size)) * glyph_size / 256.0f;
+					const float du = glyph_size / 256.0f;
+					*out_min = make_vert(x / scale, y / scale, u, v, col);
+					*out_max = make_vert(x / scale + glyph_size, y / scale + glyph_size, u + du, v + du, col);
+				};
+
+				ImDrawVert first_min, first_max;
+				glyph_corners(0, 0, &first_min, &first_max);
+				const bool blit = setup_textured_rectangle(target, texture, clip_rect, first_min, first_max).blit;
+
+				const std::string params = format("scale=%.1f alpha=%d glyph=%d", scale, alpha, glyph_size);
+				run("uniform_textured_rect", blit ? "blit" : "sampled", params, canvas, [&]() {
+					const int count = for_each_cell(pixel_size, 0, [&](int x, int y) {
+						ImDrawVert min_v, max_v;
+						glyph_corners(x, y, &min_v, &max_v);
+						paint_uniform_textured_rectangle(target, texture, clip_rect, min_v, max_v, nullptr);
+					});
+					return static_cast<double>(count) * pixel_size * pixel_size;
+				});
+			}
+		}
+	}
+	free_scaled_textures();
+}
+
+void bench_triangle(const FontTexture& font)
+{
+	const ImVec4 clip_rect(0, 0, kCanvasSize, kCanvasSize);
+
+	struct Variant
+	{
+		const char* path;
+		bool        gradient;
+		bool        textured;
+	};
+	const Variant variants[] = {
+		{"uniform",     false, false},
+		{"gradient",    true,  false},
+		{"textured",    false, true},
+		{"grad+tex",    true,  true},
+	};
+
+	for (const Variant& variant : variants) {
+		for (const int alpha : {255, 128}) {
+			for (const int size : {8, 32, 128}) {
+				Canvas canvas(Background::Flat);
+				const PaintTarget target = canvas.target(1.0f);
+				const Texture* texture = variant.textured ? &font.texture : nullptr;
+
+				const ImU32 col0 = IM_COL32(200, 100, 50, alpha);
+				const ImU32 col1 = variant.gradient ? IM_COL32(50, 100, 200, alpha) : col0;
+				const ImU32 col2 = variant.gradient ? IM_COL32(100, 200, 50, alpha) : col0;
+
+				const std::string params = format("alpha=%d size=%d", alpha, size);
+				run("triangle", variant.path, params, canvas, [&]() {
+					// Each cell is split into two triangles:
+					const int count = for_each_cell(size, 0, [&](int x, int y) {
+						const ImDrawVert vertices[4] = {
+							make_vert(x, y, 0, 0, col0),
+							make_vert(x + size, y, 1, 0, col1),
+							make_vert(x + size, y + size, 1, 1, col2),
+							make_vert(x, y + size, 0, 1, col1),
+						};
+						float px[kTransformBlock], py[kTransformBlock], r[kTransformBlock], g[kTransformBlock], b[kTransformBlock], a[kTransformBlock];
+						int32_t fixed_x[kTransformBlock], fixed_y[kTransformBlock];
+						transform_vertices(vertices, 4, target.scale, px, py, fixed_x, fixed_y, r, g, b, a);
+						const TransformedVertices transformed{vertices, px, py, fixed_x, fixed_y, r, g, b, a};
+						paint_triangle(target, texture, clip_rect, transformed, 0, 1, 2, nullptr);
+						paint_triangle(target, texture, clip_rect, transformed, 0, 2, 3, nullptr);
+					});
+					return static_cast<double>(count) * size * size;
+				});
+			}
+		}
+	}
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	s_filter = argc > 1 ? argv[1] : nullptr;
+
+	printf("%-24s %-10s %-42s %9s %9s %9s\n", "kernel", "path", "params", "ns/px", "cycles/px", "Mpx/s");
+
+	const FontTexture font;
+	bench_blend();
+	bench_sample_texture(font);
+	bench_uniform_rectangle();
+	bench_textured_rectangle(font);
+	bench_triangle(font);
+}
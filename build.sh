@@ -92,6 +92,9 @@ COMPILE_FLAGS="$COMPILE_FLAGS -DLOGURU_REDEFINE_ASSERT=1"
 
 LDLIBS="-lstdc++ -lpthread -ldl"
 LDLIBS="$LDLIBS -lSDL2"
+if [ "$(uname)" != "Darwin" ]; then
+	LDLIBS="$LDLIBS -lrt" # shm_open, for imgui_sw_shm
+fi
 
 if $OPENGL_REFERENCE_RENDERER; then
 	COMPILE_FLAGS="$COMPILE_FLAGS -DOPENGL_REFERENCE_RENDERER"
@@ -0,0 +1,53 @@
+// Example of reading frames published by imgui_sw::publish_frame from another process.
+// Build:
+//   g++ --std=c++11 -O2 -I src examples/shm_consumer.cpp src/imgui_sw_shm.cpp -o shm_consumer.bin -lrt
+// Run while the producer is running:
+//   ./shm_consumer.bin /imgui_sw
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+#include "imgui_sw_shm.hpp"
+
+int main(int argc, char* argv[])
+{
+	const char* name = argc > 1 ? argv[1] : "/imgui_sw";
+
+	imgui_sw::ShmFrameRing* ring = imgui_sw::open_frame_ring(name);
+	if (!ring) {
+		fprintf(stderr, "Failed to open frame ring '%s'. Is the producer running?\n", name);
+		return 1;
+	}
+
+	uint64_t last_sequence = 0;
+	for (int i = 0; i < 1000; ++i) {
+		imgui_sw::ShmFrame frame;
+		if (!imgui_sw::acquire_frame(ring, last_sequence, &frame)) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			continue;
+		}
+
+		// Read the damaged pixels straight out of the shared memory.
+		// A real compositor would upload them to a texture here.
+		uint32_t checksum = 0;
+		for (int y = frame.damage.min_y; y < frame.damage.max_y; ++y) {
+			for (int x = frame.damage.min_x; x < frame.damage.max_x; ++x) {
+				checksum = checksum * 31 + frame.pixels[y * frame.stride + x];
+			}
+		}
+
+		if (!imgui_sw::frame_still_valid(ring, frame)) {
+			printf("frame %llu was overwritten while reading it\n", static_cast<unsigned long long>(frame.sequence));
+			continue; // Read the next one.
+		}
+
+		const bool missed_frames = frame.sequence > last_sequence + 1;
+		printf("frame %llu: damage [%d, %d) x [%d, %d)%s, checksum %08x\n",
+			static_cast<unsigned long long>(frame.sequence),
+			frame.damage.min_x, frame.damage.max_x, frame.damage.min_y, frame.damage.max_y,
+			missed_frames ? " (missed frames, so everything is damaged)" : "", checksum);
+		last_sequence = frame.sequence;
+	}
+
+	imgui_sw::destroy_frame_ring(ring);
+}
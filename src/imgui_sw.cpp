@@ -6,7 +6,12 @@
 #include "imgui_sw.hpp"
 
 #include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <chrono>
 #include <cmath>
+#include <cstdio>
+#include <cstring>
 #include <vector>
 
 #include <imgui/imgui.h>
@@ -14,6 +19,7 @@
 namespace imgui_sw {
 namespace {
 
+// Pixel counts per primitive type, shown by show_stats. Pass nullptr to not collect these.
 struct Stats
 {
 	int    uniform_triangle_pixels            = 0;
@@ -33,12 +39,49 @@ struct Texture
 	int            height;
 };
 
+// Side of the square tiles used to track which parts of the frame are painted to. Must be a power of two.
+const int kTileShift = 4;
+const int kTileSize = 1 << kTileShift;
+
 struct PaintTarget
 {
 	uint32_t* pixels;
 	int       width;
 	int       height;
+	int       stride; // Number of pixels between the starts of two rows.
 	ImVec2    scale; // Multiply ImGui (point) coordinates with this to get pixel coordinates.
+	int       width_tiles; // Number of tiles per row of tiles (rounded up). See damage.
+	int       band_min_y; // We only paint rows [band_min_y, band_max_y).
+	int       band_max_y; // pixels starts at row band_min_y.
+	uint8_t*  damage; // Optional. One byte per tile of the frame, set to 1 when the tile is painted to.
+	uint16_t* overdraw; // Optional. One counter per pixel of the frame, incremented each time the pixel is painted.
+	bool      layer; // If true, pixels start out transparent and are kept premultiplied by their alpha. See paint_imgui_yuv.
+
+	/// Mark the tiles covering the pixels [min, max) as painted to.
+	void mark_damage(int min_x, int min_y, int max_x, int max_y) const
+	{
+		if (!damage || min_x >= max_x || min_y >= max_y) { return; }
+		for (int ty = min_y >> kTileShift; ty <= (max_y - 1) >> kTileShift; ++ty) {
+			for (int tx = min_x >> kTileShift; tx <= (max_x - 1) >> kTileShift; ++tx) {
+				damage[ty * width_tiles + tx] = 1;
+			}
+		}
+	}
+
+	/// The pixels of row y, indexed by x.
+	uint32_t* row(int y) const
+	{
+		return pixels + (y - band_min_y) * stride;
+	}
+
+	void count_overdraw(int y, int min_x, int max_x) const
+	{
+		if (!overdraw) { return; }
+		uint16_t* row = overdraw + y * width;
+		for (int x = min_x; x < max_x; ++x) {
+			row[x] += 1;
+		}
+	}
 };
 
 // ----------------------------------------------------------------------------
@@ -73,6 +116,21 @@ ColorInt blend(ColorInt target, ColorInt source)
 	return result;
 }
 
+// Like blend, but also computes the alpha of the result, for painting onto a transparent layer (see PaintTarget::layer).
+// If target is premultiplied by its alpha, so is the result.
+ColorInt blend_layer(ColorInt target, ColorInt source)
+{
+	ColorInt result = blend(target, source);
+	result.a = source.a + target.a * (255 - source.a) / 255;
+	return result;
+}
+
+template<bool kLayer>
+ColorInt blend_pixel(ColorInt target, ColorInt source)
+{
+	return kLayer ? blend_layer(target, source) : blend(target, source);
+}
+
 // ----------------------------------------------------------------------------
 // Used for interpolating vertex attributes (color and texture coordinates) in a triangle.
 
@@ -156,29 +214,20 @@ ImU32 color_convert_float4_to_u32(const ImVec4& in)
 
 // ----------------------------------------------------------------------------
 // For fast and subpixel-perfect triangle rendering we used fixed point arithmetic.
-// To keep the code simple we use 64 bits to avoid overflows.
+// paint_triangle clips huge triangles to a guard band around the target, so coordinates fit in 32 bits.
+// Their cross products do not, so orient2d uses 64 bits.
 
 using Int = int64_t;
-const Int kFixedBias = 256;
+const int32_t kFixedBias = 256;
 
 struct Point
 {
-	Int x, y;
+	int32_t x, y;
 };
 
 Int orient2d(const Point& a, const Point& b, const Point& c)
 {
-	return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
-}
-
-Int as_int(float v)
-{
-	return static_cast<Int>(std::floor(v * kFixedBias));
-}
-
-Point as_point(ImVec2 v)
-{
-	return Point{as_int(v.x), as_int(v.y)};
+	return static_cast<Int>(b.x - a.x) * (c.y - a.y) - static_cast<Int>(b.y - a.y) * (c.x - a.x);
 }
 
 // ----------------------------------------------------------------------------
@@ -214,6 +263,7 @@ inline uint8_t sample_texture(const Texture& texture, const ImVec2& uv)
 	return texture.pixels[ty * texture.width + tx];
 }
 
+template<bool kLayer>
 void paint_uniform_rectangle(
 	const PaintTarget& target,
 	const ImVec2&      min_f,
@@ -229,41 +279,203 @@ void paint_uniform_rectangle(
 
 	// Clamp to render target:
 	min_x_i = std::max(min_x_i, 0);
-	min_y_i = std::max(min_y_i, 0);
+	min_y_i = std::max(min_y_i, target.band_min_y);
 	max_x_i = std::min(max_x_i, target.width);
-	max_y_i = std::min(max_y_i, target.height);
+	max_y_i = std::min(max_y_i, target.band_max_y);
+
+	if (min_x_i >= max_x_i || min_y_i >= max_y_i) { return; }
 
-	stats->uniform_rectangle_pixels += (max_x_i - min_x_i) * (max_y_i - min_y_i);
+	target.mark_damage(min_x_i, min_y_i, max_x_i, max_y_i);
+	if (stats) { stats->uniform_rectangle_pixels += (max_x_i - min_x_i) * (max_y_i - min_y_i); }
 
 	// We often blend the same colors over and over again, so optimize for this (saves 25% total cpu):
-	uint32_t last_target_pixel = target.pixels[min_y_i * target.width + min_x_i];
-	uint32_t last_output = blend(ColorInt(last_target_pixel), color).toUint32();
+	uint32_t last_target_pixel = target.row(min_y_i)[min_x_i];
+	uint32_t last_output = blend_pixel<kLayer>(ColorInt(last_target_pixel), color).toUint32();
 
 	for (int y = min_y_i; y < max_y_i; ++y) {
+		target.count_overdraw(y, min_x_i, max_x_i);
+		uint32_t* target_row = target.row(y);
 		for (int x = min_x_i; x < max_x_i; ++x) {
-			uint32_t& target_pixel = target.pixels[y * target.width + x];
+			uint32_t& target_pixel = target_row[x];
 			if (target_pixel == last_target_pixel) {
 				target_pixel = last_output;
 				continue;
 			}
 			last_target_pixel = target_pixel;
-			target_pixel = blend(ColorInt(target_pixel), color).toUint32();
+			target_pixel = blend_pixel<kLayer>(ColorInt(target_pixel), color).toUint32();
 			last_output = target_pixel;
 		}
 	}
 }
 
-void paint_uniform_textured_rectangle(
+void paint_uniform_rectangle(
+	const PaintTarget& target,
+	const ImVec2&      min_f,
+	const ImVec2&      max_f,
+	const ColorInt&    color,
+	Stats*             stats)
+{
+	if (target.layer) {
+		paint_uniform_rectangle<true>(target, min_f, max_f, color, stats);
+	} else {
+		paint_uniform_rectangle<false>(target, min_f, max_f, color, stats);
+	}
+}
+
+int round_to_int(float v)
+{
+	return static_cast<int>(std::floor(v + 0.5f));
+}
+
+// ----------------------------------------------------------------------------
+// When painting at a scale other than one, glyphs are taken from a copy of the font texture
+// that has been resampled to that scale. This way they can be copied 1:1 instead of being
+// point-sampled from the original texture. The copies are kept until the scale changes.
+// A draw command painting into several targets uses several copies at once. These are pinned,
+// so that looking up the texture for one target never replaces the one of another.
+
+struct ScaledTexture
+{
+	const Texture*       source = nullptr;
+	ImVec2               scale;
+	std::vector<uint8_t> pixels;
+	Texture              texture;
+	bool                 pinned = false; // Returned since the last unpin_scaled_textures.
+};
+
+const int kMaxScaledTextures = 4; // One per scale in use.
+ScaledTexture s_scaled_textures[kMaxScaledTextures];
+int s_next_scaled_texture = 0;
+
+void resample_texture(const Texture& source, ScaledTexture* scaled)
+{
+	const int width = std::max(1, round_to_int(source.width * scaled->scale.x));
+	const int height = std::max(1, round_to_int(source.height * scaled->scale.y));
+	scaled->pixels.resize(width * height);
+
+	// Bilinear interpolation:
+	for (int y = 0; y < height; ++y) {
+		const float src_y = std::max(0.0f, (y + 0.5f) * source.height / height - 0.5f);
+		const int y0 = std::min(static_cast<int>(src_y), source.height - 1);
+		const int y1 = std::min(y0 + 1, source.height - 1);
+		const float ty = src_y - y0;
+
+		for (int x = 0; x < width; ++x) {
+			const float src_x = std::max(0.0f, (x + 0.5f) * source.width / width - 0.5f);
+			const int x0 = std::min(static_cast<int>(src_x), source.width - 1);
+			const int x1 = std::min(x0 + 1, source.width - 1);
+			const float tx = src_x - x0;
+
+			const float top    = (1 - tx) * source.pixels[y0 * source.width + x0] + tx * source.pixels[y0 * source.width + x1];
+			const float bottom = (1 - tx) * source.pixels[y1 * source.width + x0] + tx * source.pixels[y1 * source.width + x1];
+			scaled->pixels[y * width + x] = static_cast<uint8_t>((1 - ty) * top + ty * bottom + 0.5f);
+		}
+	}
+
+	scaled->texture = Texture{scaled->pixels.data(), width, height};
+}
+
+const Texture& texture_at_scale(const Texture& source, const ImVec2& scale)
+{
+	if (scale.x == 1.0f && scale.y == 1.0f) { return source; }
+
+	for (ScaledTexture& scaled : s_scaled_textures) {
+		if (scaled.source == &source && scaled.scale.x == scale.x && scaled.scale.y == scale.y) {
+			scaled.pinned = true;
+			return scaled.texture;
+		}
+	}
+
+	// Replace the next copy in round robin order that is not pinned:
+	int slot = s_next_scaled_texture;
+	for (int i = 0; i < kMaxScaledTextures && s_scaled_textures[slot].pinned; ++i) {
+		slot = (slot + 1) % kMaxScaledTextures;
+	}
+	assert(!s_scaled_textures[slot].pinned && "More scales in use at once than kMaxScaledTextures");
+	s_next_scaled_texture = (slot + 1) % kMaxScaledTextures;
+
+	ScaledTexture& scaled = s_scaled_textures[slot];
+	scaled.pinned = true;
+	scaled.source = &source;
+	scaled.scale = scale;
+	resample_texture(source, &scaled);
+	return scaled.texture;
+}
+
+/// Allow all copies to be replaced again.
+void unpin_scaled_textures()
+{
+	for (ScaledTexture& scaled : s_scaled_textures) {
+		scaled.pinned = false;
+	}
+}
+
+void free_scaled_textures()
+{
+	for (ScaledTexture& scaled : s_scaled_textures) {
+		scaled = ScaledTexture{};
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+// The bounding box and texture coordinate stepping of a textured rectangle.
+struct TexturedRect
+{
+	int    min_x_i, min_y_i, max_x_i, max_y_i; // Integer bounding box [min, max)
+	ImVec2 uv_topleft;
+	ImVec2 delta_uv_per_pixel;
+	bool   blit; // If true, pixel (x, y) is painted with texel (x + texel_offset_x, y + texel_offset_y).
+	int    texel_offset_x;
+	int    texel_offset_y;
+};
+
+TexturedRect setup_textured_rectangle(
 	const PaintTarget& target,
 	const Texture&     texture,
 	const ImVec4&      clip_rect,
 	const ImDrawVert&  min_v,
-	const ImDrawVert&  max_v,
-	Stats*             stats)
+	const ImDrawVert&  max_v)
 {
 	const ImVec2 min_p = ImVec2(target.scale.x * min_v.pos.x, target.scale.y * min_v.pos.y);
 	const ImVec2 max_p = ImVec2(target.scale.x * max_v.pos.x, target.scale.y * max_v.pos.y);
 
+	const int width_i = round_to_int(max_p.x - min_p.x);
+	const int height_i = round_to_int(max_p.y - min_p.y);
+
+	if (width_i > 0 && height_i > 0 &&
+	    width_i == round_to_int((max_v.uv.x - min_v.uv.x) * texture.width) &&
+	    height_i == round_to_int((max_v.uv.y - min_v.uv.y) * texture.height))
+	{
+		// The glyph covers as many pixels as it has texels, so we can copy them 1:1:
+		TexturedRect rect;
+		rect.blit = true;
+
+		const int min_x = round_to_int(min_p.x);
+		const int min_y = round_to_int(min_p.y);
+		rect.texel_offset_x = round_to_int(min_v.uv.x * texture.width) - min_x;
+		rect.texel_offset_y = round_to_int(min_v.uv.y * texture.height) - min_y;
+
+		// Clip against clip_rect:
+		rect.min_x_i = std::max(min_x, static_cast<int>(target.scale.x * clip_rect.x));
+		rect.min_y_i = std::max(min_y, static_cast<int>(target.scale.y * clip_rect.y));
+		rect.max_x_i = std::min(min_x + width_i, static_cast<int>(target.scale.x * clip_rect.z + 0.5f));
+		rect.max_y_i = std::min(min_y + height_i, static_cast<int>(target.scale.y * clip_rect.w + 0.5f));
+
+		// Clip against texture:
+		rect.min_x_i = std::max(rect.min_x_i, -rect.texel_offset_x);
+		rect.min_y_i = std::max(rect.min_y_i, -rect.texel_offset_y);
+		rect.max_x_i = std::min(rect.max_x_i, texture.width - rect.texel_offset_x);
+		rect.max_y_i = std::min(rect.max_y_i, texture.height - rect.texel_offset_y);
+
+		// Clip against render target:
+		rect.min_x_i = std::max(rect.min_x_i, 0);
+		rect.min_y_i = std::max(rect.min_y_i, target.band_min_y);
+		rect.max_x_i = std::min(rect.max_x_i, target.width);
+		rect.max_y_i = std::min(rect.max_y_i, target.band_max_y);
+		return rect;
+	}
+
 	// Find bounding box:
 	float min_x_f = min_p.x;
 	float min_y_f = min_p.y;
@@ -276,215 +488,329 @@ void paint_uniform_textured_rectangle(
 	max_x_f = std::min(max_x_f, target.scale.x * clip_rect.z - 0.5f);
 	max_y_f = std::min(max_y_f, target.scale.y * clip_rect.w - 0.5f);
 
+	TexturedRect rect;
+	rect.blit = false;
+
 	// Integer bounding box [min, max):
-	int min_x_i = static_cast<int>(min_x_f);
-	int min_y_i = static_cast<int>(min_y_f);
-	int max_x_i = static_cast<int>(max_x_f + 1.0f);
-	int max_y_i = static_cast<int>(max_y_f + 1.0f);
+	rect.min_x_i = static_cast<int>(min_x_f);
+	rect.min_y_i = static_cast<int>(min_y_f);
+	rect.max_x_i = static_cast<int>(max_x_f + 1.0f);
+	rect.max_y_i = static_cast<int>(max_y_f + 1.0f);
 
 	// Clip against render target:
-	min_x_i = std::max(min_x_i, 0);
-	min_y_i = std::max(min_y_i, 0);
-	max_x_i = std::min(max_x_i, target.width);
-	max_y_i = std::min(max_y_i, target.height);
+	const int frame_min_y_i = std::max(rect.min_y_i, 0); // The first row when not painting in bands.
+	rect.min_x_i = std::max(rect.min_x_i, 0);
+	rect.min_y_i = std::max(rect.min_y_i, target.band_min_y);
+	rect.max_x_i = std::min(rect.max_x_i, target.width);
+	rect.max_y_i = std::min(rect.max_y_i, target.band_max_y);
 
-	stats->font_pixels += (max_x_i - min_x_i) * (max_y_i - min_y_i);
-
-	const auto topleft = ImVec2(min_x_i + 0.5f * target.scale.x,
-	                            min_y_i + 0.5f * target.scale.y);
+	const auto topleft = ImVec2(rect.min_x_i + 0.5f * target.scale.x,
+	                            frame_min_y_i + 0.5f * target.scale.y);
 
-	const ImVec2 delta_uv_per_pixel = {
+	rect.delta_uv_per_pixel = {
 		(max_v.uv.x - min_v.uv.x) / (max_p.x - min_p.x),
 		(max_v.uv.y - min_v.uv.y) / (max_p.y - min_p.y),
 	};
-	const ImVec2 uv_topleft = {
-		min_v.uv.x + (topleft.x - min_v.pos.x) * delta_uv_per_pixel.x,
-		min_v.uv.y + (topleft.y - min_v.pos.y) * delta_uv_per_pixel.y,
+	rect.uv_topleft = {
+		min_v.uv.x + (topleft.x - min_v.pos.x) * rect.delta_uv_per_pixel.x,
+		min_v.uv.y + (topleft.y - min_v.pos.y) * rect.delta_uv_per_pixel.y,
 	};
-	ImVec2 current_uv = uv_topleft;
-
-	for (int y = min_y_i; y < max_y_i; ++y, current_uv.y += delta_uv_per_pixel.y) {
-		current_uv.x = uv_topleft.x;
-		for (int x = min_x_i; x < max_x_i; ++x, current_uv.x += delta_uv_per_pixel.x) {
-			uint32_t& target_pixel = target.pixels[y * target.width + x];
-			const uint8_t texel = sample_texture(texture, current_uv);
-
-			// The font texture is all black or all white, so optimize for this:
-			if (texel == 0) { continue; }
-			if (texel == 255) {
-				target_pixel = min_v.col;
-				continue;
-			}
 
-			// Other textured rectangles
-			ColorInt source_color = ColorInt(min_v.col);
-			source_color.a = source_color.a * texel / 255;
-			target_pixel = blend(ColorInt(target_pixel), source_color).toUint32();
-		}
+	// Step down to the band row by row, like the painting does, so a band samples the same texels as the whole frame:
+	for (int y = frame_min_y_i; y < rect.min_y_i; ++y) {
+		rect.uv_topleft.y += rect.delta_uv_per_pixel.y;
 	}
+	return rect;
 }
 
-// When two triangles share an edge, we want to draw the pixels on that edge exactly once.
-// The edge will be the same, but the direction will be the opposite
-// (assuming the two triangles have the same winding order).
-// Which edge wins? This functions decides.
-bool is_dominant_edge(ImVec2 edge)
+template<bool kLayer>
+inline void paint_font_pixel(uint32_t& target_pixel, uint8_t texel, ImU32 col)
 {
-	// return edge.x < 0 || (edge.x == 0 && edge.y > 0);
-	return edge.y > 0 || (edge.y == 0 && edge.x < 0);
+	// The font texture is all black or all white, so optimize for this:
+	if (texel == 0) { return; }
+	// A layer must keep the alpha of translucent text:
+	if (texel == 255 && (!kLayer || ((col >> IM_COL32_A_SHIFT) & 0xFFu) == 0xFFu)) {
+		target_pixel = col;
+		return;
+	}
+
+	// Other textured rectangles
+	ColorInt source_color = ColorInt(col);
+	source_color.a = source_color.a * texel / 255;
+	target_pixel = blend_pixel<kLayer>(ColorInt(target_pixel), source_color).toUint32();
 }
 
-// Handles triangles in any winding order (CW/CCW)
-void paint_triangle(
+template<bool kLayer>
+void paint_uniform_textured_rectangle(
 	const PaintTarget& target,
-	const Texture*     texture,
+	const Texture&     texture,
 	const ImVec4&      clip_rect,
-	const ImDrawVert&  v0,
-	const ImDrawVert&  v1,
-	const ImDrawVert&  v2,
+	const ImDrawVert&  min_v,
+	const ImDrawVert&  max_v,
 	Stats*             stats)
 {
-	const ImVec2 p0 = ImVec2(target.scale.x * v0.pos.x, target.scale.y * v0.pos.y);
-	const ImVec2 p1 = ImVec2(target.scale.x * v1.pos.x, target.scale.y * v1.pos.y);
-	const ImVec2 p2 = ImVec2(target.scale.x * v2.pos.x, target.scale.y * v2.pos.y);
+	const TexturedRect rect = setup_textured_rectangle(target, texture, clip_rect, min_v, max_v);
+
+	target.mark_damage(rect.min_x_i, rect.min_y_i, rect.max_x_i, rect.max_y_i);
+	if (stats) { stats->font_pixels += (rect.max_x_i - rect.min_x_i) * (rect.max_y_i - rect.min_y_i); }
+
+	if (rect.blit) {
+		for (int y = rect.min_y_i; y < rect.max_y_i; ++y) {
+			const uint8_t* texels = texture.pixels + (y + rect.texel_offset_y) * texture.width + rect.texel_offset_x;
+			target.count_overdraw(y, rect.min_x_i, rect.max_x_i);
+			uint32_t* target_row = target.row(y);
+			for (int x = rect.min_x_i; x < rect.max_x_i; ++x) {
+				paint_font_pixel<kLayer>(target_row[x], texels[x], min_v.col);
+			}
+		}
+		return;
+	}
 
-	const auto rect_area = barycentric(p0, p1, p2); // Can be positive or negative depending on winding order
-	if (rect_area == 0.0f) { return; }
-	// if (rect_area < 0.0f) { return paint_triangle(target, texture, clip_rect, v0, v2, v1, stats); }
+	ImVec2 current_uv = rect.uv_topleft;
 
-	// Find bounding box:
-	float min_x_f = min3(p0.x, p1.x, p2.x);
-	float min_y_f = min3(p0.y, p1.y, p2.y);
-	float max_x_f = max3(p0.x, p1.x, p2.x);
-	float max_y_f = max3(p0.y, p1.y, p2.y);
+	for (int y = rect.min_y_i; y < rect.max_y_i; ++y, current_uv.y += rect.delta_uv_per_pixel.y) {
+		current_uv.x = rect.uv_topleft.x;
+		target.count_overdraw(y, rect.min_x_i, rect.max_x_i);
+		uint32_t* target_row = target.row(y);
+		for (int x = rect.min_x_i; x < rect.max_x_i; ++x, current_uv.x += rect.delta_uv_per_pixel.x) {
+			paint_font_pixel<kLayer>(target_row[x], sample_texture(texture, current_uv), min_v.col);
+		}
+	}
+}
 
-	// Clip against clip_rect:
-	min_x_f = std::max(min_x_f, target.scale.x * clip_rect.x);
-	min_y_f = std::max(min_y_f, target.scale.y * clip_rect.y);
-	max_x_f = std::min(max_x_f, target.scale.x * clip_rect.z - 0.5f);
-	max_y_f = std::min(max_y_f, target.scale.y * clip_rect.w - 0.5f);
+void paint_uniform_textured_rectangle(
+	const PaintTarget& target,
+	const Texture&     texture,
+	const ImVec4&      clip_rect,
+	const ImDrawVert&  min_v,
+	const ImDrawVert&  max_v,
+	Stats*             stats)
+{
+	if (target.layer) {
+		paint_uniform_textured_rectangle<true>(target, texture, clip_rect, min_v, max_v, stats);
+	} else {
+		paint_uniform_textured_rectangle<false>(target, texture, clip_rect, min_v, max_v, stats);
+	}
+}
 
-	// Integer bounding box [min, max):
-	int min_x_i = static_cast<int>(min_x_f);
-	int min_y_i = static_cast<int>(min_y_f);
-	int max_x_i = static_cast<int>(max_x_f + 1.0f);
-	int max_y_i = static_cast<int>(max_y_f + 1.0f);
+// ----------------------------------------------------------------------------
+// A line of text is a sequence of glyph quads of the same color.
+// ImGui gives each glyph its own tight box, so the glyphs of a line cover different
+// but overlapping rows. We collect these and paint them one row at a time across all glyphs.
+// This keeps the target row and the font texture rows in cache,
+// and we only do the setup once per glyph.
 
-	// Clip against render target:
-	min_x_i = std::max(min_x_i, 0);
-	min_y_i = std::max(min_y_i, 0);
-	max_x_i = std::min(max_x_i, target.width);
-	max_y_i = std::min(max_y_i, target.height);
+struct TextRun
+{
+	std::vector<ImDrawVert>   corners; // (min, max) vertex pairs, one per glyph.
+	std::vector<TexturedRect> rects;   // Scratch space used when painting.
+	float                     min_y;   // The rows covered by the glyphs so far, in points.
+	float                     max_y;
 
-	// ------------------------------------------------------------------------
-	// Set up interpolation of barycentric coordinates:
+	bool empty() const { return corners.empty(); }
 
-	const auto topleft = ImVec2(min_x_i + 0.5f * target.scale.x,
-	                            min_y_i + 0.5f * target.scale.y);
-	const auto dx = ImVec2(1, 0);
-	const auto dy = ImVec2(0, 1);
+	/// Glyphs on the same line overlap the rows of the run. Glyphs on the next line do not.
+	bool can_append(const ImDrawVert& min_v, const ImDrawVert& max_v) const
+	{
+		return corners.empty() || (
+			min_v.pos.y < max_y &&
+			max_v.pos.y > min_y &&
+			min_v.col   == corners[0].col);
+	}
 
-	const auto w0_topleft = barycentric(p1, p2, topleft);
-	const auto w1_topleft = barycentric(p2, p0, topleft);
-	const auto w2_topleft = barycentric(p0, p1, topleft);
+	void append(const ImDrawVert& min_v, const ImDrawVert& max_v)
+	{
+		if (corners.empty()) {
+			min_y = min_v.pos.y;
+			max_y = max_v.pos.y;
+		} else {
+			min_y = std::min(min_y, min_v.pos.y);
+			max_y = std::max(max_y, max_v.pos.y);
+		}
+		corners.push_back(min_v);
+		corners.push_back(max_v);
+	}
+};
 
-	const auto w0_dx = barycentric(p1, p2, topleft + dx) - w0_topleft;
-	const auto w1_dx = barycentric(p2, p0, topleft + dx) - w1_topleft;
-	const auto w2_dx = barycentric(p0, p1, topleft + dx) - w2_topleft;
+template<bool kLayer>
+void paint_text_run(
+	const PaintTarget& target,
+	const Texture&     texture,
+	const ImVec4&      clip_rect,
+	TextRun*           run,
+	Stats*             stats)
+{
+	if (run->empty()) { return; }
 
-	const auto w0_dy = barycentric(p1, p2, topleft + dy) - w0_topleft;
-	const auto w1_dy = barycentric(p2, p0, topleft + dy) - w1_topleft;
-	const auto w2_dy = barycentric(p0, p1, topleft + dy) - w2_topleft;
+	const ImU32 col = run->corners[0].col;
 
-	const Barycentric bary_0 { 1, 0, 0 };
-	const Barycentric bary_1 { 0, 1, 0 };
-	const Barycentric bary_2 { 0, 0, 1 };
+	run->rects.clear();
+	for (size_t i = 0; i < run->corners.size(); i += 2) {
+		const TexturedRect rect = setup_textured_rectangle(target, texture, clip_rect, run->corners[i], run->corners[i + 1]);
+		target.mark_damage(rect.min_x_i, rect.min_y_i, rect.max_x_i, rect.max_y_i);
+		if (stats) { stats->font_pixels += (rect.max_x_i - rect.min_x_i) * (rect.max_y_i - rect.min_y_i); }
+		if (rect.min_x_i < rect.max_x_i && rect.min_y_i < rect.max_y_i) {
+			run->rects.push_back(rect);
+		}
+	}
 
-	const auto inv_area = 1 / rect_area;
-	const Barycentric bary_topleft = inv_area * (w0_topleft * bary_0 + w1_topleft * bary_1 + w2_topleft * bary_2);
-	const Barycentric bary_dx      = inv_area * (w0_dx      * bary_0 + w1_dx      * bary_1 + w2_dx      * bary_2);
-	const Barycentric bary_dy      = inv_area * (w0_dy      * bary_0 + w1_dy      * bary_1 + w2_dy      * bary_2);
+	if (run->rects.empty()) { return; }
 
-	Barycentric bary_current_row = bary_topleft;
+	// Glyphs on one line cover different, but overlapping, rows.
+	// Painting row by row still paints each pixel in the same glyph order as painting glyph by glyph.
+	int min_y_i = run->rects[0].min_y_i;
+	int max_y_i = run->rects[0].max_y_i;
+	for (const TexturedRect& rect : run->rects) {
+		min_y_i = std::min(min_y_i, rect.min_y_i);
+		max_y_i = std::max(max_y_i, rect.max_y_i);
+	}
 
-	// ------------------------------------------------------------------------
-	// For pixel-perfect inside/outside testing:
+	for (int y = min_y_i; y < max_y_i; ++y) {
+		uint32_t* target_row = target.row(y);
+		for (TexturedRect& rect : run->rects) {
+			if (y < rect.min_y_i || rect.max_y_i <= y) { continue; }
+			target.count_overdraw(y, rect.min_x_i, rect.max_x_i);
+
+			if (rect.blit) {
+				const uint8_t* texels = texture.pixels + (y + rect.texel_offset_y) * texture.width + rect.texel_offset_x;
+				for (int x = rect.min_x_i; x < rect.max_x_i; ++x) {
+					paint_font_pixel<kLayer>(target_row[x], texels[x], col);
+				}
+				continue;
+			}
 
-	const int sign = rect_area > 0 ? 1 : -1; // winding order?
+			ImVec2 current_uv = rect.uv_topleft;
+			for (int x = rect.min_x_i; x < rect.max_x_i; ++x, current_uv.x += rect.delta_uv_per_pixel.x) {
+				paint_font_pixel<kLayer>(target_row[x], sample_texture(texture, current_uv), col);
+			}
+			rect.uv_topleft.y += rect.delta_uv_per_pixel.y;
+		}
+	}
+}
 
-	const int bias0i = is_dominant_edge(p2 - p1) ? 0 : -1;
-	const int bias1i = is_dominant_edge(p0 - p2) ? 0 : -1;
-	const int bias2i = is_dominant_edge(p1 - p0) ? 0 : -1;
+void paint_text_run(
+	const PaintTarget& target,
+	const Texture&     texture,
+	const ImVec4&      clip_rect,
+	TextRun*           run,
+	Stats*             stats)
+{
+	if (target.layer) {
+		paint_text_run<true>(target, texture, clip_rect, run, stats);
+	} else {
+		paint_text_run<false>(target, texture, clip_rect, run, stats);
+	}
+}
 
-	const auto p0i = as_point(p0);
-	const auto p1i = as_point(p1);
-	const auto p2i = as_point(p2);
+// The most targets that paint_draw_list can paint into at once. One scaled font texture each.
+const int kMaxPaintTargets = kMaxScaledTextures;
+
+/// Paint the run into each target, then start a new run.
+void flush_text_run(
+	const PaintTarget*    targets,
+	const Texture* const* glyph_textures,
+	int                   num_targets,
+	const ImVec4&         clip_rect,
+	TextRun*              run,
+	Stats*                stats)
+{
+	for (int t = 0; t < num_targets; ++t) {
+		paint_text_run(targets[t], *glyph_textures[t], clip_rect, run, t == 0 ? stats : nullptr);
+	}
+	run->corners.clear();
+}
 
-	// ------------------------------------------------------------------------
+// When two triangles share an edge, we want to draw the pixels on that edge exactly once.
+// The edge will be the same, but the direction will be the opposite
+// (assuming the two triangles have the same winding order).
+// Which edge wins? This functions decides.
+bool is_dominant_edge(ImVec2 edge)
+{
+	// return edge.x < 0 || (edge.x == 0 && edge.y > 0);
+	return edge.y > 0 || (edge.y == 0 && edge.x < 0);
+}
 
-	const bool has_uniform_color = (v0.col == v1.col && v0.col == v2.col);
+// Everything the inner loop of a triangle needs, computed once per triangle.
+struct TriangleSetup
+{
+	int         min_x_i, min_y_i, max_x_i, max_y_i; // Integer bounding box [min, max)
+	Barycentric bary_topleft, bary_dx, bary_dy;
+	int         sign; // Winding order
+	int         bias0i, bias1i, bias2i;
+	Point       p0i, p1i, p2i;
+	ImU32       col; // Of the first vertex.
+	ImVec4      c0, c1, c2;
+	ImVec2      uv0, uv1, uv2;
+};
 
-	const ImVec4 c0 = color_convert_u32_to_float4(v0.col);
-	const ImVec4 c1 = color_convert_u32_to_float4(v1.col);
-	const ImVec4 c2 = color_convert_u32_to_float4(v2.col);
+// The inner loop of paint_triangle, specialized so that no per-pixel work depends
+// on properties that are the same for the whole triangle.
+template<bool kUniformColor, bool kTextured, bool kLayer, bool kStats>
+void rasterize_triangle(
+	const PaintTarget&   target,
+	const Texture*       texture,
+	const TriangleSetup& setup,
+	Stats*               stats)
+{
+	int num_pixels = 0;
 
 	// We often blend the same colors over and over again, so optimize for this (saves 10% total cpu):
 	uint32_t last_target_pixel = 0;
-	uint32_t last_output = blend(ColorInt(last_target_pixel), ColorInt(v0.col)).toUint32();
+	uint32_t last_output = blend_pixel<kLayer>(ColorInt(last_target_pixel), ColorInt(setup.col)).toUint32();
 
-	for (int y = min_y_i; y < max_y_i; ++y) {
+	Barycentric bary_current_row = setup.bary_topleft;
+
+	for (int y = setup.min_y_i; y < setup.max_y_i; ++y) {
 		auto bary = bary_current_row;
+		uint32_t* target_row = target.row(y);
 
 		bool has_been_inside_this_row = false;
+		int first_inside_x = setup.max_x_i;
+		int end_inside_x = setup.max_x_i;
 
-		for (int x = min_x_i; x < max_x_i; ++x) {
+		for (int x = setup.min_x_i; x < setup.max_x_i; ++x) {
 			const auto w0 = bary.w0;
 			const auto w1 = bary.w1;
 			const auto w2 = bary.w2;
-			bary += bary_dx;
+			bary += setup.bary_dx;
 
 			{
 				// Inside/outside test:
 				const auto p = Point{kFixedBias * x + kFixedBias / 2, kFixedBias * y + kFixedBias / 2};
-				const auto w0i = sign * orient2d(p1i, p2i, p) + bias0i;
-				const auto w1i = sign * orient2d(p2i, p0i, p) + bias1i;
-				const auto w2i = sign * orient2d(p0i, p1i, p) + bias2i;
+				const auto w0i = setup.sign * orient2d(setup.p1i, setup.p2i, p) + setup.bias0i;
+				const auto w1i = setup.sign * orient2d(setup.p2i, setup.p0i, p) + setup.bias1i;
+				const auto w2i = setup.sign * orient2d(setup.p0i, setup.p1i, p) + setup.bias2i;
 				if (w0i < 0 || w1i < 0 || w2i < 0) {
 					if (has_been_inside_this_row) {
+						end_inside_x = x;
 						break; // Gives a nice 10% speedup
 					} else {
 						continue;
 					}
 				}
 			}
+			if (!has_been_inside_this_row) { first_inside_x = x; }
 			has_been_inside_this_row = true;
 
-			uint32_t& target_pixel = target.pixels[y * target.width + x];
+			if (kStats) { num_pixels += 1; }
+
+			uint32_t& target_pixel = target_row[x];
 
-			if (has_uniform_color && !texture) {
-				stats->uniform_triangle_pixels += 1;
+			if (kUniformColor && !kTextured) {
 				if (target_pixel == last_target_pixel) {
 					target_pixel = last_output;
 					continue;
 				}
 				last_target_pixel = target_pixel;
-				target_pixel = blend(ColorInt(target_pixel), ColorInt(v0.col)).toUint32();
+				target_pixel = blend_pixel<kLayer>(ColorInt(target_pixel), ColorInt(setup.col)).toUint32();
 				last_output = target_pixel;
 				continue;
 			}
 
-			ImVec4 src_color;
-
-			if (has_uniform_color) {
-				src_color = c0;
-			} else {
-				stats->gradient_triangle_pixels += 1;
-				src_color = w0 * c0 + w1 * c1 + w2 * c2;
-			}
+			ImVec4 src_color = kUniformColor ? setup.c0 : w0 * setup.c0 + w1 * setup.c1 + w2 * setup.c2;
 
-			if (texture) {
-				stats->textured_triangle_pixels += 1;
-				const ImVec2 uv = w0 * v0.uv + w1 * v1.uv + w2 * v2.uv;
+			if (kTextured) {
+				const ImVec2 uv = w0 * setup.uv0 + w1 * setup.uv1 + w2 * setup.uv2;
 				src_color.w *= sample_texture(*texture, uv) / 255.0f;
 			}
 
@@ -496,37 +822,532 @@ void paint_triangle(
 			}
 
 			ImVec4 target_color = color_convert_u32_to_float4(target_pixel);
-			const auto blended_color = src_color.w * src_color + (1.0f - src_color.w) * target_color;
+			auto blended_color = src_color.w * src_color + (1.0f - src_color.w) * target_color;
+			if (kLayer) { blended_color.w = src_color.w + (1.0f - src_color.w) * target_color.w; }
 			target_pixel = color_convert_float4_to_u32(blended_color);
 		}
 
-		bary_current_row += bary_dy;
+		target.count_overdraw(y, first_inside_x, end_inside_x);
+		bary_current_row += setup.bary_dy;
+	}
+
+	if (kStats) {
+		if (kUniformColor && !kTextured) { stats->uniform_triangle_pixels += num_pixels; }
+		if (!kUniformColor) { stats->gradient_triangle_pixels += num_pixels; }
+		if (kTextured) { stats->textured_triangle_pixels += num_pixels; }
 	}
 }
 
-void paint_draw_cmd(
-	const PaintTarget& target,
-	const ImDrawVert*  vertices,
-	const ImDrawIdx*   idx_buffer,
-	const ImDrawCmd&   pcmd,
-	const SwOptions&   options,
-	Stats*             stats)
+template<bool kUniformColor, bool kTextured>
+void rasterize_triangle(
+	const PaintTarget&   target,
+	const Texture*       texture,
+	const TriangleSetup& setup,
+	Stats*               stats)
 {
-	const auto texture = reinterpret_cast<const Texture*>(pcmd.TextureId);
-	assert(texture);
+	if (target.layer) {
+		if (stats) {
+			rasterize_triangle<kUniformColor, kTextured, true, true>(target, texture, setup, stats);
+		} else {
+			rasterize_triangle<kUniformColor, kTextured, true, false>(target, texture, setup, stats);
+		}
+	} else {
+		if (stats) {
+			rasterize_triangle<kUniformColor, kTextured, false, true>(target, texture, setup, stats);
+		} else {
+			rasterize_triangle<kUniformColor, kTextured, false, false>(target, texture, setup, stats);
+		}
+	}
+}
 
-	// ImGui uses the first pixel for "white".
-	const ImVec2 white_uv = ImVec2(0.5f / texture->width, 0.5f / texture->height);
+// ----------------------------------------------------------------------------
+// ImGui meshes are indexed, and most vertices are shared by several triangles.
+// So we transform each vertex of a draw list to pixel space once per target, instead of once per triangle.
+// The results are stored as a structure of arrays, so that the loops doing it can be vectorized.
 
-	for (int i = 0; i + 3 <= pcmd.ElemCount; ) {
-		const ImDrawVert& v0 = vertices[idx_buffer[i + 0]];
-		const ImDrawVert& v1 = vertices[idx_buffer[i + 1]];
-		const ImDrawVert& v2 = vertices[idx_buffer[i + 2]];
+/// The vertices of a draw list, transformed to a paint target. Indexed like the ImDrawVert.
+struct TransformedVertices
+{
+	const ImDrawVert* vertices; // For uv and col.
+	const float*      x;        // Position in pixels.
+	const float*      y;
+	const int32_t*    fixed_x;  // Position in fixed point. Only valid inside of the guard band.
+	const int32_t*    fixed_y;
+	const float*      r;        // Color in [0, 1], as color_convert_u32_to_float4.
+	const float*      g;
+	const float*      b;
+	const float*      a;
+};
 
-		// Text is common, and is made of textured rectangles. So let's optimize for it.
-		// This assumes the ImGui way to layout text does not change.
-		if (options.optimize_text && i + 6 <= pcmd.ElemCount &&
-		    idx_buffer[i + 3] == idx_buffer[i + 0] && idx_buffer[i + 4] == idx_buffer[i + 2]) {
+// Vertices are transformed in blocks of this many, with one loop of exactly this length per output array.
+// GCC only vectorizes at -O2 if a loop needs no scalar remainder and no runtime alias checks.
+const int kTransformBlock = 8;
+
+/// The first count (at most kTransformBlock) vertices are transformed.
+/// All kTransformBlock elements of each output are written.
+void transform_block(
+	const ImDrawVert* vertices,
+	int               count,
+	float             scale_x,
+	float             scale_y,
+	float*            x,
+	float*            y,
+	int32_t*          fixed_x,
+	int32_t*          fixed_y,
+	float*            r,
+	float*            g,
+	float*            b,
+	float*            a)
+{
+	// Gathering from ImDrawVert is scalar. The loops after it only read these local arrays,
+	// which cannot alias the outputs.
+	float pos_x[kTransformBlock] = {};
+	float pos_y[kTransformBlock] = {};
+	ImU32 col[kTransformBlock] = {};
+	for (int i = 0; i < count; ++i) {
+		pos_x[i] = vertices[i].pos.x;
+		pos_y[i] = vertices[i].pos.y;
+		col[i]   = vertices[i].col;
+	}
+
+	for (int i = 0; i < kTransformBlock; ++i) { x[i] = scale_x * pos_x[i]; }
+	for (int i = 0; i < kTransformBlock; ++i) { y[i] = scale_y * pos_y[i]; }
+
+	// floor(v * kFixedBias). Clamped first, so the conversion is defined far outside of the guard band.
+	// Clamping and rounding in the same loop keeps GCC from if-converting it, so they are two loops.
+	const float kMaxFixed = 1073741824.0f; // 2^30
+	float clamped_x[kTransformBlock];
+	float clamped_y[kTransformBlock];
+	for (int i = 0; i < kTransformBlock; ++i) { clamped_x[i] = std::min(std::max(scale_x * pos_x[i] * kFixedBias, -kMaxFixed), kMaxFixed); }
+	for (int i = 0; i < kTransformBlock; ++i) { clamped_y[i] = std::min(std::max(scale_y * pos_y[i] * kFixedBias, -kMaxFixed), kMaxFixed); }
+	for (int i = 0; i < kTransformBlock; ++i) {
+		const int32_t truncated = static_cast<int32_t>(clamped_x[i]); // Rounds towards zero...
+		fixed_x[i] = truncated - (clamped_x[i] < truncated ? 1 : 0);  // ...so round negative fractions down.
+	}
+	for (int i = 0; i < kTransformBlock; ++i) {
+		const int32_t truncated = static_cast<int32_t>(clamped_y[i]);
+		fixed_y[i] = truncated - (clamped_y[i] < truncated ? 1 : 0);
+	}
+
+	const float s = 1.0f / 255.0f;
+	for (int i = 0; i < kTransformBlock; ++i) { r[i] = ((col[i] >> IM_COL32_R_SHIFT) & 0xFF) * s; }
+	for (int i = 0; i < kTransformBlock; ++i) { g[i] = ((col[i] >> IM_COL32_G_SHIFT) & 0xFF) * s; }
+	for (int i = 0; i < kTransformBlock; ++i) { b[i] = ((col[i] >> IM_COL32_B_SHIFT) & 0xFF) * s; }
+	for (int i = 0; i < kTransformBlock; ++i) { a[i] = ((col[i] >> IM_COL32_A_SHIFT) & 0xFF) * s; }
+}
+
+/// Round up to a whole number of blocks. The outputs of transform_vertices must have room for this many.
+int padded_vertex_count(int num_vertices)
+{
+	return (num_vertices + kTransformBlock - 1) / kTransformBlock * kTransformBlock;
+}
+
+void transform_vertices(
+	const ImDrawVert* vertices,
+	int               num_vertices,
+	const ImVec2&     scale,
+	float*            x,
+	float*            y,
+	int32_t*          fixed_x,
+	int32_t*          fixed_y,
+	float*            r,
+	float*            g,
+	float*            b,
+	float*            a)
+{
+	const float scale_x = scale.x; // Copied, since scale could alias the outputs.
+	const float scale_y = scale.y;
+	for (int i = 0; i < num_vertices; i += kTransformBlock) {
+		transform_block(vertices + i, std::min(kTransformBlock, num_vertices - i), scale_x, scale_y,
+		                x + i, y + i, fixed_x + i, fixed_y + i, r + i, g + i, b + i, a + i);
+	}
+}
+
+/// Owns the arrays behind TransformedVertices for one draw list and paint target.
+/// Kept between frames, so the arrays are only reallocated when a draw list grows.
+struct VertexCache
+{
+	std::vector<float>   x, y, r, g, b, a;
+	std::vector<int32_t> fixed_x, fixed_y;
+	uint64_t             generation = 0; // When the arrays were last filled in.
+	std::vector<uint8_t> in_core; // See update_core.
+	uint64_t             core_generation = 0;
+
+	/// Transform the vertices, unless that was already done in this generation.
+	TransformedVertices update(const ImDrawVert* vertices, int num_vertices, const ImVec2& scale, uint64_t current_generation)
+	{
+		if (generation != current_generation) {
+			const int padded = padded_vertex_count(num_vertices);
+			x.resize(padded);
+			y.resize(padded);
+			fixed_x.resize(padded);
+			fixed_y.resize(padded);
+			r.resize(padded);
+			g.resize(padded);
+			b.resize(padded);
+			a.resize(padded);
+			transform_vertices(vertices, num_vertices, scale, x.data(), y.data(), fixed_x.data(), fixed_y.data(),
+			                   r.data(), g.data(), b.data(), a.data());
+			generation = current_generation;
+		}
+		return TransformedVertices{vertices, x.data(), y.data(), fixed_x.data(), fixed_y.data(),
+		                           r.data(), g.data(), b.data(), a.data()};
+	}
+
+	/// in_core[v] is 1 if vertex v is a corner of a triangle without any transparent corner.
+	/// Only recomputed if the generation has changed.
+	const uint8_t* update_core(const ImDrawList* cmd_list, uint64_t current_generation)
+	{
+		if (core_generation != current_generation) {
+			const ImU32 alpha_mask = 0xFFu << IM_COL32_A_SHIFT;
+			const ImDrawIdx* idx_buffer = cmd_list->IdxBuffer.Data;
+			const ImDrawVert* vertices = cmd_list->VtxBuffer.Data;
+			in_core.assign(cmd_list->VtxBuffer.Size, 0);
+			for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.size(); cmd_i++) {
+				const ImDrawCmd& pcmd = cmd_list->CmdBuffer[cmd_i];
+				if (!pcmd.UserCallback) {
+					for (unsigned int i = 0; i + 3 <= pcmd.ElemCount; i += 3) {
+						const ImDrawIdx i0 = idx_buffer[i + 0], i1 = idx_buffer[i + 1], i2 = idx_buffer[i + 2];
+						if ((vertices[i0].col & alpha_mask) != 0 &&
+						    (vertices[i1].col & alpha_mask) != 0 &&
+						    (vertices[i2].col & alpha_mask) != 0) {
+							in_core[i0] = in_core[i1] = in_core[i2] = 1;
+						}
+					}
+				}
+				idx_buffer += pcmd.ElemCount;
+			}
+			core_generation = current_generation;
+		}
+		return in_core.data();
+	}
+};
+
+// Triangles reaching more than this many pixels outside of the target are clipped to half of it
+// before setup. This keeps the fixed point coordinates small and the barycentric setup precise.
+const float kGuardBand = 8192.0f;
+
+ImDrawVert lerp_vertex(const ImDrawVert& a, const ImDrawVert& b, float t)
+{
+	ImDrawVert result;
+	result.pos = (1.0f - t) * a.pos + t * b.pos;
+	result.uv  = (1.0f - t) * a.uv  + t * b.uv;
+	if (a.col == b.col) {
+		result.col = a.col;
+	} else {
+		const ImVec4 color = (1.0f - t) * color_convert_u32_to_float4(a.col) + t * color_convert_u32_to_float4(b.col);
+		result.col = color_convert_float4_to_u32(color);
+	}
+	return result;
+}
+
+/// Sutherland-Hodgman: keep the part of the convex polygon in where sign * (pos[axis] - limit) <= 0.
+/// Returns the number of vertices written to out, which must have room for num_in + 1 of them.
+int clip_polygon(const ImDrawVert* in, int num_in, ImDrawVert* out, int axis, float sign, float limit)
+{
+	int num_out = 0;
+	for (int i = 0; i < num_in; ++i) {
+		const ImDrawVert& a = in[i];
+		const ImDrawVert& b = in[(i + 1) % num_in];
+		const float dist_a = sign * ((axis == 0 ? a.pos.x : a.pos.y) - limit);
+		const float dist_b = sign * ((axis == 0 ? b.pos.x : b.pos.y) - limit);
+		if (dist_a <= 0.0f) { out[num_out++] = a; }
+		if ((dist_a <= 0.0f) != (dist_b <= 0.0f)) {
+			out[num_out++] = lerp_vertex(a, b, dist_a / (dist_a - dist_b));
+		}
+	}
+	return num_out;
+}
+
+void paint_triangle(
+	const PaintTarget&         target,
+	const Texture*             texture,
+	const ImVec4&              clip_rect,
+	const TransformedVertices& transformed,
+	int                        i0,
+	int                        i1,
+	int                        i2,
+	Stats*                     stats);
+
+/// Clip the triangle against the inner half of the guard band, and paint what is left as a triangle fan.
+void paint_guard_band_clipped_triangle(
+	const PaintTarget& target,
+	const Texture*     texture,
+	const ImVec4&      clip_rect,
+	const ImDrawVert&  v0,
+	const ImDrawVert&  v1,
+	const ImDrawVert&  v2,
+	Stats*             stats)
+{
+	const float margin = 0.5f * kGuardBand;
+	const float min_x = -margin / target.scale.x;
+	const float min_y = -margin / target.scale.y; // The whole frame, not the band, so each band clips the same way.
+	const float max_x = (target.width + margin) / target.scale.x;
+	const float max_y = (target.height + margin) / target.scale.y;
+
+	// Each clip adds at most one vertex:
+	ImDrawVert polygon[7] = {v0, v1, v2};
+	ImDrawVert clipped[7];
+	int n = 3;
+	n = clip_polygon(polygon, n, clipped, 0, -1.0f, min_x);
+	n = clip_polygon(clipped, n, polygon, 0, +1.0f, max_x);
+	n = clip_polygon(polygon, n, clipped, 1, -1.0f, min_y);
+	n = clip_polygon(clipped, n, polygon, 1, +1.0f, max_y);
+
+	float x[kTransformBlock], y[kTransformBlock], r[kTransformBlock], g[kTransformBlock], b[kTransformBlock], a[kTransformBlock];
+	int32_t fixed_x[kTransformBlock], fixed_y[kTransformBlock];
+	transform_vertices(polygon, n, target.scale, x, y, fixed_x, fixed_y, r, g, b, a);
+	const TransformedVertices transformed{polygon, x, y, fixed_x, fixed_y, r, g, b, a};
+
+	for (int i = 1; i + 1 < n; ++i) {
+		paint_triangle(target, texture, clip_rect, transformed, 0, i, i + 1, stats);
+	}
+}
+
+// Handles triangles in any winding order (CW/CCW)
+void paint_triangle(
+	const PaintTarget&         target,
+	const Texture*             texture,
+	const ImVec4&              clip_rect,
+	const TransformedVertices& transformed,
+	int                        i0,
+	int                        i1,
+	int                        i2,
+	Stats*                     stats)
+{
+	const ImDrawVert& v0 = transformed.vertices[i0];
+	const ImDrawVert& v1 = transformed.vertices[i1];
+	const ImDrawVert& v2 = transformed.vertices[i2];
+
+	const ImVec2 p0 = ImVec2(transformed.x[i0], transformed.y[i0]);
+	const ImVec2 p1 = ImVec2(transformed.x[i1], transformed.y[i1]);
+	const ImVec2 p2 = ImVec2(transformed.x[i2], transformed.y[i2]);
+
+	if (min3(p0.x, p1.x, p2.x) < -kGuardBand || max3(p0.x, p1.x, p2.x) > target.width + kGuardBand ||
+	    min3(p0.y, p1.y, p2.y) < -kGuardBand || max3(p0.y, p1.y, p2.y) > target.height + kGuardBand) {
+		return paint_guard_band_clipped_triangle(target, texture, clip_rect, v0, v1, v2, stats);
+	}
+
+	const auto rect_area = barycentric(p0, p1, p2); // Can be positive or negative depending on winding order
+	if (rect_area == 0.0f) { return; }
+	// if (rect_area < 0.0f) { return paint_triangle(target, texture, clip_rect, v0, v2, v1, stats); }
+
+	// Find bounding box:
+	float min_x_f = min3(p0.x, p1.x, p2.x);
+	float min_y_f = min3(p0.y, p1.y, p2.y);
+	float max_x_f = max3(p0.x, p1.x, p2.x);
+	float max_y_f = max3(p0.y, p1.y, p2.y);
+
+	// Clip against clip_rect:
+	min_x_f = std::max(min_x_f, target.scale.x * clip_rect.x);
+	min_y_f = std::max(min_y_f, target.scale.y * clip_rect.y);
+	max_x_f = std::min(max_x_f, target.scale.x * clip_rect.z - 0.5f);
+	max_y_f = std::min(max_y_f, target.scale.y * clip_rect.w - 0.5f);
+
+	// Integer bounding box [min, max):
+	int min_x_i = static_cast<int>(min_x_f);
+	int min_y_i = static_cast<int>(min_y_f);
+	int max_x_i = static_cast<int>(max_x_f + 1.0f);
+	int max_y_i = static_cast<int>(max_y_f + 1.0f);
+
+	// Clip against render target:
+	const int frame_min_y_i = std::max(min_y_i, 0); // The first row when not painting in bands.
+	min_x_i = std::max(min_x_i, 0);
+	min_y_i = std::max(min_y_i, target.band_min_y);
+	max_x_i = std::min(max_x_i, target.width);
+	max_y_i = std::min(max_y_i, target.band_max_y);
+
+	if (min_x_i >= max_x_i || min_y_i >= max_y_i) { return; }
+
+	target.mark_damage(min_x_i, min_y_i, max_x_i, max_y_i);
+
+	// ------------------------------------------------------------------------
+	// Set up interpolation of barycentric coordinates:
+
+	const auto topleft = ImVec2(min_x_i + 0.5f * target.scale.x,
+	                            frame_min_y_i + 0.5f * target.scale.y);
+	const auto dx = ImVec2(1, 0);
+	const auto dy = ImVec2(0, 1);
+
+	const auto w0_topleft = barycentric(p1, p2, topleft);
+	const auto w1_topleft = barycentric(p2, p0, topleft);
+	const auto w2_topleft = barycentric(p0, p1, topleft);
+
+	const auto w0_dx = barycentric(p1, p2, topleft + dx) - w0_topleft;
+	const auto w1_dx = barycentric(p2, p0, topleft + dx) - w1_topleft;
+	const auto w2_dx = barycentric(p0, p1, topleft + dx) - w2_topleft;
+
+	const auto w0_dy = barycentric(p1, p2, topleft + dy) - w0_topleft;
+	const auto w1_dy = barycentric(p2, p0, topleft + dy) - w1_topleft;
+	const auto w2_dy = barycentric(p0, p1, topleft + dy) - w2_topleft;
+
+	const Barycentric bary_0 { 1, 0, 0 };
+	const Barycentric bary_1 { 0, 1, 0 };
+	const Barycentric bary_2 { 0, 0, 1 };
+
+	const auto inv_area = 1 / rect_area;
+	Barycentric       bary_topleft = inv_area * (w0_topleft * bary_0 + w1_topleft * bary_1 + w2_topleft * bary_2);
+	const Barycentric bary_dx      = inv_area * (w0_dx      * bary_0 + w1_dx      * bary_1 + w2_dx      * bary_2);
+	const Barycentric bary_dy      = inv_area * (w0_dy      * bary_0 + w1_dy      * bary_1 + w2_dy      * bary_2);
+
+	// Step down to the band row by row, like rasterize_triangle does, so a band interpolates exactly like the whole frame:
+	for (int y = frame_min_y_i; y < min_y_i; ++y) {
+		bary_topleft += bary_dy;
+	}
+
+	// ------------------------------------------------------------------------
+	// For pixel-perfect inside/outside testing:
+
+	const int sign = rect_area > 0 ? 1 : -1; // winding order?
+
+	const int bias0i = is_dominant_edge(p2 - p1) ? 0 : -1;
+	const int bias1i = is_dominant_edge(p0 - p2) ? 0 : -1;
+	const int bias2i = is_dominant_edge(p1 - p0) ? 0 : -1;
+
+	const Point p0i{transformed.fixed_x[i0], transformed.fixed_y[i0]};
+	const Point p1i{transformed.fixed_x[i1], transformed.fixed_y[i1]};
+	const Point p2i{transformed.fixed_x[i2], transformed.fixed_y[i2]};
+
+	// ------------------------------------------------------------------------
+
+	TriangleSetup setup;
+	setup.min_x_i      = min_x_i;
+	setup.min_y_i      = min_y_i;
+	setup.max_x_i      = max_x_i;
+	setup.max_y_i      = max_y_i;
+	setup.bary_topleft = bary_topleft;
+	setup.bary_dx      = bary_dx;
+	setup.bary_dy      = bary_dy;
+	setup.sign         = sign;
+	setup.bias0i       = bias0i;
+	setup.bias1i       = bias1i;
+	setup.bias2i       = bias2i;
+	setup.p0i          = p0i;
+	setup.p1i          = p1i;
+	setup.p2i          = p2i;
+	setup.col          = v0.col;
+	setup.c0           = ImVec4(transformed.r[i0], transformed.g[i0], transformed.b[i0], transformed.a[i0]);
+	setup.c1           = ImVec4(transformed.r[i1], transformed.g[i1], transformed.b[i1], transformed.a[i1]);
+	setup.c2           = ImVec4(transformed.r[i2], transformed.g[i2], transformed.b[i2], transformed.a[i2]);
+	setup.uv0          = v0.uv;
+	setup.uv1          = v1.uv;
+	setup.uv2          = v2.uv;
+
+	const bool has_uniform_color = (v0.col == v1.col && v0.col == v2.col);
+
+	if (has_uniform_color) {
+		if (texture) {
+			rasterize_triangle<true, true>(target, texture, setup, stats);
+		} else {
+			rasterize_triangle<true, false>(target, texture, setup, stats);
+		}
+	} else {
+		if (texture) {
+			rasterize_triangle<false, true>(target, texture, setup, stats);
+		} else {
+			rasterize_triangle<false, false>(target, texture, setup, stats);
+		}
+	}
+}
+
+/// The part of clip_rect (in points) that can touch a pixel in any of the targets,
+/// with a margin of one pixel for rounding.
+ImVec4 cull_rectangle(const PaintTarget* targets, int num_targets, const ImVec4& clip_rect)
+{
+	ImVec4 cull_rect(FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (int t = 0; t < num_targets; ++t) {
+		const PaintTarget& target = targets[t];
+		const float margin_x = 1.0f / target.scale.x;
+		const float margin_y = 1.0f / target.scale.y;
+		cull_rect.x = std::min(cull_rect.x, std::max(clip_rect.x, 0.0f) - margin_x);
+		cull_rect.y = std::min(cull_rect.y, std::max(clip_rect.y, target.band_min_y / target.scale.y) - margin_y);
+		cull_rect.z = std::max(cull_rect.z, std::min(clip_rect.z, target.width / target.scale.x) + margin_x);
+		cull_rect.w = std::max(cull_rect.w, std::min(clip_rect.w, target.band_max_y / target.scale.y) + margin_y);
+	}
+	return cull_rect;
+}
+
+// ImGui anti-aliases edges with a strip of triangles one point wide (AA_SIZE in imgui_draw.cpp),
+// fading from the color of the shape to the same color with zero alpha.
+// The slack is for the joins of polylines, where the strip is a bit wider.
+const float kMaxFringeWidth = 1.5f; // In points.
+
+/// Gradients to transparent (like the color picker) also have zero alpha vertices,
+/// but they are much wider than an anti-aliasing fringe.
+/// Thin lines (thickness <= 1) are nothing but two fringes fading out from the center line,
+/// so a fringe is only skipped if its visible vertices are all on the opaque core of a shape (see VertexCache::update_core).
+bool is_aa_fringe(const ImDrawVert* vertices, const uint8_t* in_core, ImDrawIdx i0, ImDrawIdx i1, ImDrawIdx i2)
+{
+	const ImDrawVert& v0 = vertices[i0];
+	const ImDrawVert& v1 = vertices[i1];
+	const ImDrawVert& v2 = vertices[i2];
+	const ImU32 alpha_mask = 0xFFu << IM_COL32_A_SHIFT;
+	const bool has_transparent = (v0.col & alpha_mask) == 0 || (v1.col & alpha_mask) == 0 || (v2.col & alpha_mask) == 0;
+	const bool has_visible     = (v0.col & alpha_mask) != 0 || (v1.col & alpha_mask) != 0 || (v2.col & alpha_mask) != 0;
+	const bool same_rgb = ((v0.col ^ v1.col) & ~alpha_mask) == 0 && ((v0.col ^ v2.col) & ~alpha_mask) == 0;
+	if (!has_transparent || !has_visible || !same_rgb) { return false; }
+
+	if (((v0.col & alpha_mask) != 0 && !in_core[i0]) ||
+	    ((v1.col & alpha_mask) != 0 && !in_core[i1]) ||
+	    ((v2.col & alpha_mask) != 0 && !in_core[i2])) {
+		return false;
+	}
+
+	// The width of the triangle is its height over its longest edge:
+	const ImVec2 e0 = v1.pos - v0.pos;
+	const ImVec2 e1 = v2.pos - v1.pos;
+	const ImVec2 e2 = v0.pos - v2.pos;
+	const float twice_area = std::abs(e0.x * e2.y - e0.y * e2.x);
+	const float longest_sq = std::max(std::max(e0.x * e0.x + e0.y * e0.y, e1.x * e1.x + e1.y * e1.y), e2.x * e2.x + e2.y * e2.y);
+	return twice_area * twice_area <= kMaxFringeWidth * kMaxFringeWidth * longest_sq;
+}
+
+// Each primitive is classified once, then painted into each of the targets.
+// Stats are only collected for the first target.
+void paint_draw_cmd(
+	const PaintTarget*         targets,
+	int                        num_targets,
+	const ImDrawVert*          vertices,
+	const TransformedVertices* transformed,
+	const uint8_t*             in_core, // Only needed with options.skip_aa_fringes.
+	const ImDrawIdx*           idx_buffer,
+	const ImDrawCmd&           pcmd,
+	const SwOptions&           options,
+	TextRun*                   text_run,
+	Stats*                     stats)
+{
+	const auto texture = reinterpret_cast<const Texture*>(pcmd.TextureId);
+	assert(texture);
+
+	// ImGui uses the first pixel for "white".
+	const ImVec2 white_uv = ImVec2(0.5f / texture->width, 0.5f / texture->height);
+
+	assert(num_targets <= kMaxPaintTargets);
+	// Look up all targets before painting any, with the textures of earlier targets pinned:
+	const Texture* glyph_textures[kMaxPaintTargets];
+	unpin_scaled_textures();
+	for (int t = 0; t < num_targets; ++t) {
+		glyph_textures[t] = &texture_at_scale(*texture, targets[t].scale);
+	}
+
+	// In scrolled lists most primitives are outside the clip rect. Skip these before anything else:
+	const ImVec4 cull_rect = cull_rectangle(targets, num_targets, pcmd.ClipRect);
+
+	for (int i = 0; i + 3 <= pcmd.ElemCount; ) {
+		const ImDrawVert& v0 = vertices[idx_buffer[i + 0]];
+		const ImDrawVert& v1 = vertices[idx_buffer[i + 1]];
+		const ImDrawVert& v2 = vertices[idx_buffer[i + 2]];
+
+		if (max3(v0.pos.y, v1.pos.y, v2.pos.y) < cull_rect.y || min3(v0.pos.y, v1.pos.y, v2.pos.y) > cull_rect.w ||
+		    max3(v0.pos.x, v1.pos.x, v2.pos.x) < cull_rect.x || min3(v0.pos.x, v1.pos.x, v2.pos.x) > cull_rect.z) {
+			i += 3;
+			continue;
+		}
+
+		// Text is common, and is made of textured rectangles. So let's optimize for it.
+		// This assumes the ImGui way to layout text does not change.
+		if (options.optimize_text && i + 6 <= pcmd.ElemCount &&
+		    idx_buffer[i + 3] == idx_buffer[i + 0] && idx_buffer[i + 4] == idx_buffer[i + 2]) {
 			const ImDrawVert& v3 = vertices[idx_buffer[i + 5]];
 
 			if (v0.pos.x == v3.pos.x &&
@@ -551,13 +1372,25 @@ void paint_draw_cmd(
 
 				if (has_uniform_color && has_texture)
 				{
-					paint_uniform_textured_rectangle(target, *texture, pcmd.ClipRect, v0, v2, stats);
+					if (options.batch_text) {
+						if (!text_run->can_append(v0, v2)) {
+							flush_text_run(targets, glyph_textures, num_targets, pcmd.ClipRect, text_run, stats);
+						}
+						text_run->append(v0, v2);
+					} else {
+						for (int t = 0; t < num_targets; ++t) {
+							paint_uniform_textured_rectangle(targets[t], *glyph_textures[t], pcmd.ClipRect, v0, v2, t == 0 ? stats : nullptr);
+						}
+					}
 					i += 6;
 					continue;
 				}
 			}
 		}
 
+		// Anything painted after a text run must be painted on top of it:
+		flush_text_run(targets, glyph_textures, num_targets, pcmd.ClipRect, text_run, stats);
+
 		// A lot of the big stuff are uniformly colored rectangles,
 		// so we can save a lot of CPU by detecting them:
 		if (options.optimize_rectangles && i + 6 <= pcmd.ElemCount) {
@@ -609,51 +1442,450 @@ void paint_draw_cmd(
 
 				if (max.x < min.x || max.y < min.y) { i+=6; continue; } // Completely clipped
 
-				const auto num_pixels = (max.x - min.x) * (max.y - min.y) * target.scale.x * target.scale.y;
+				const auto num_pixels = (max.x - min.x) * (max.y - min.y) * targets[0].scale.x * targets[0].scale.y;
 
 				if (has_uniform_color) {
 					if (has_texture) {
-						stats->textured_rectangle_pixels += num_pixels;
+						if (stats) { stats->textured_rectangle_pixels += num_pixels; }
 					} else {
-						paint_uniform_rectangle(target, min, max, ColorInt(v0.col), stats);
+						for (int t = 0; t < num_targets; ++t) {
+							paint_uniform_rectangle(targets[t], min, max, ColorInt(v0.col), t == 0 ? stats : nullptr);
+						}
 						i += 6;
 						continue;
 					}
 				} else {
 					if (has_texture) {
 						// I have never encountered these.
-						stats->gradient_textured_rectangle_pixels += num_pixels;
+						if (stats) { stats->gradient_textured_rectangle_pixels += num_pixels; }
 					} else {
 						// Color picker. TODO: Optimize
-						stats->gradient_rectangle_pixels += num_pixels;
+						if (stats) { stats->gradient_rectangle_pixels += num_pixels; }
 					}
 				}
 			}
 		}
 
+		if (options.skip_aa_fringes && is_aa_fringe(vertices, in_core, idx_buffer[i + 0], idx_buffer[i + 1], idx_buffer[i + 2])) {
+			i += 3;
+			continue;
+		}
+
 		const bool has_texture = (v0.uv != white_uv || v1.uv != white_uv || v2.uv != white_uv);
-		paint_triangle(target, has_texture ? texture : nullptr, pcmd.ClipRect, v0, v1, v2, stats);
+		for (int t = 0; t < num_targets; ++t) {
+			paint_triangle(targets[t], has_texture ? texture : nullptr, pcmd.ClipRect, transformed[t],
+			               idx_buffer[i + 0], idx_buffer[i + 1], idx_buffer[i + 2], t == 0 ? stats : nullptr);
+		}
 		i += 3;
 	}
+
+	flush_text_run(targets, glyph_textures, num_targets, pcmd.ClipRect, text_run, stats);
 }
 
-void paint_draw_list(const PaintTarget& target, const ImDrawList* cmd_list, const SwOptions& options, Stats* stats)
+const SwPaintContext* s_paint_context = nullptr; // Only set while calling a draw callback.
+int s_draw_callback_depth = 0; // Number of draw callbacks we are inside. Painting from one must use other vertex caches.
+
+SwPaintContext paint_context(const PaintTarget& target, const ImVec4& clip_rect)
+{
+	SwPaintContext context;
+	context.pixels      = target.pixels;
+	context.width       = target.width;
+	context.height      = target.height;
+	context.stride      = target.stride;
+	context.band_min_y  = target.band_min_y;
+	context.band_max_y  = target.band_max_y;
+	context.scale_x     = target.scale.x;
+	context.scale_y     = target.scale.y;
+	context.clip_min_x  = std::max(static_cast<int>(target.scale.x * clip_rect.x + 0.5f), 0);
+	context.clip_min_y  = std::max(static_cast<int>(target.scale.y * clip_rect.y + 0.5f), target.band_min_y);
+	context.clip_max_x  = std::min(static_cast<int>(target.scale.x * clip_rect.z + 0.5f), target.width);
+	context.clip_max_y  = std::min(static_cast<int>(target.scale.y * clip_rect.w + 0.5f), target.band_max_y);
+#ifdef IMGUI_USE_BGRA_PACKED_COLOR
+	context.format      = SwPixelFormat::ARGB;
+#else
+	context.format      = SwPixelFormat::ABGR;
+#endif
+	return context;
+}
+
+/// Paint the draw list into each of the targets (at most kMaxPaintTargets) in one pass.
+/// Draw callbacks are called once per target.
+/// vertex_caches has one cache per target. These are only updated if vertex_generation has changed.
+void paint_draw_list(
+	const PaintTarget* targets,
+	int                num_targets,
+	const ImDrawList*  cmd_list,
+	VertexCache*       vertex_caches,
+	uint64_t           vertex_generation,
+	const SwOptions&   options,
+	TextRun*           text_run,
+	Stats*             stats)
 {
 	const ImDrawIdx* idx_buffer = &cmd_list->IdxBuffer[0];
 	const ImDrawVert* vertices = cmd_list->VtxBuffer.Data;
 
+	assert(num_targets <= kMaxPaintTargets);
+	TransformedVertices transformed[kMaxPaintTargets];
+	for (int t = 0; t < num_targets; ++t) {
+		transformed[t] = vertex_caches[t].update(vertices, cmd_list->VtxBuffer.Size, targets[t].scale, vertex_generation);
+	}
+	const uint8_t* in_core = options.skip_aa_fringes ? vertex_caches[0].update_core(cmd_list, vertex_generation) : nullptr;
+
 	for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.size(); cmd_i++)
 	{
 		const ImDrawCmd& pcmd = cmd_list->CmdBuffer[cmd_i];
 		if (pcmd.UserCallback) {
-			pcmd.UserCallback(cmd_list, &pcmd);
+			for (int t = 0; t < num_targets; ++t) {
+				const SwPaintContext context = paint_context(targets[t], pcmd.ClipRect);
+				targets[t].mark_damage(context.clip_min_x, context.clip_min_y, context.clip_max_x, context.clip_max_y);
+				s_paint_context = &context;
+				s_draw_callback_depth += 1;
+				pcmd.UserCallback(cmd_list, &pcmd);
+				s_draw_callback_depth -= 1;
+				s_paint_context = nullptr;
+			}
 		} else {
-			paint_draw_cmd(target, vertices, idx_buffer, pcmd, options, stats);
+			// Only paint into the targets (or bands of them) that the clip rect overlaps:
+			PaintTarget visible_targets[kMaxPaintTargets];
+			TransformedVertices visible_transformed[kMaxPaintTargets];
+			int num_visible = 0;
+			bool first_is_visible = false;
+			for (int t = 0; t < num_targets; ++t) {
+				if (targets[t].scale.x * pcmd.ClipRect.x < targets[t].width &&
+				    targets[t].scale.x * pcmd.ClipRect.z > 0.0f &&
+				    targets[t].scale.y * pcmd.ClipRect.y < targets[t].band_max_y &&
+				    targets[t].scale.y * pcmd.ClipRect.w > targets[t].band_min_y &&
+				    pcmd.ClipRect.x < pcmd.ClipRect.z && pcmd.ClipRect.y < pcmd.ClipRect.w) {
+					first_is_visible |= t == 0;
+					visible_targets[num_visible] = targets[t];
+					visible_transformed[num_visible] = transformed[t];
+					num_visible += 1;
+				}
+			}
+			if (num_visible > 0) {
+				paint_draw_cmd(visible_targets, num_visible, vertices, visible_transformed, in_core, idx_buffer, pcmd, options, text_run,
+				               first_is_visible ? stats : nullptr);
+			}
 		}
 		idx_buffer += pcmd.ElemCount;
 	}
 }
 
+// ----------------------------------------------------------------------------
+// Which tiles of the frame the UI can paint to, found before painting anything.
+
+/// Set covered[tile] = 1 for each tile of the target that the draw data may paint to.
+/// This is conservative: the bounding box of each draw command, clipped and padded by a pixel.
+void mark_covered_tiles(const PaintTarget& target, const ImDrawData* draw_data, uint8_t* covered)
+{
+	PaintTarget coverage = target;
+	coverage.damage = covered;
+
+	for (int i = 0; i < draw_data->CmdListsCount; ++i) {
+		const ImDrawList* cmd_list = draw_data->CmdLists[i];
+		const ImDrawIdx* idx_buffer = cmd_list->IdxBuffer.Data;
+		const ImDrawVert* vertices = cmd_list->VtxBuffer.Data;
+
+		for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.size(); cmd_i++) {
+			const ImDrawCmd& pcmd = cmd_list->CmdBuffer[cmd_i];
+			if (pcmd.UserCallback) {
+				const SwPaintContext context = paint_context(target, pcmd.ClipRect);
+				coverage.mark_damage(context.clip_min_x, context.clip_min_y, context.clip_max_x, context.clip_max_y);
+				continue;
+			}
+
+			ImVec2 min(FLT_MAX, FLT_MAX), max(-FLT_MAX, -FLT_MAX);
+			for (unsigned int e = 0; e < pcmd.ElemCount; ++e) {
+				const ImVec2& pos = vertices[idx_buffer[e]].pos;
+				min.x = std::min(min.x, pos.x);
+				min.y = std::min(min.y, pos.y);
+				max.x = std::max(max.x, pos.x);
+				max.y = std::max(max.y, pos.y);
+			}
+			idx_buffer += pcmd.ElemCount;
+
+			// Clamp in floats first, since vertices can be far outside of the target:
+			const float min_x = std::max(target.scale.x * std::max(min.x, pcmd.ClipRect.x), 0.0f);
+			const float min_y = std::max(target.scale.y * std::max(min.y, pcmd.ClipRect.y), 0.0f);
+			const float max_x = std::min(target.scale.x * std::min(max.x, pcmd.ClipRect.z), static_cast<float>(target.width));
+			const float max_y = std::min(target.scale.y * std::min(max.y, pcmd.ClipRect.w), static_cast<float>(target.height));
+			if (max_x < min_x || max_y < min_y) { continue; }
+
+			coverage.mark_damage(
+				std::max(static_cast<int>(min_x) - 1, 0),
+				std::max(static_cast<int>(min_y) - 1, 0),
+				std::min(static_cast<int>(max_x) + 2, target.width),
+				std::min(static_cast<int>(max_y) + 2, target.height));
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------
+// Encoded frames, as produced by paint_imgui_encoded.
+// All integers are little-endian. The layout is:
+//   u32 kFrameMagic, u32 width, u32 height, u32 num_tiles
+//   num_tiles x { u32 tile_index, run-length encoded tile pixels }
+// The tile pixels are the kTileSize x kTileSize pixels of the tile (clipped to the frame), row by row.
+// Each run starts with a byte n. If the high bit is set, (n & 0x7F) + 1 literal u32 pixels follow.
+// Else a single u32 follows, to be repeated n + 1 times.
+
+const uint32_t kFrameMagic = 0x31575349; // "ISW1"
+const int kMaxRunLength = 128;
+
+void append_u32(std::vector<uint8_t>* out, uint32_t value)
+{
+	out->push_back(static_cast<uint8_t>(value));
+	out->push_back(static_cast<uint8_t>(value >> 8));
+	out->push_back(static_cast<uint8_t>(value >> 16));
+	out->push_back(static_cast<uint8_t>(value >> 24));
+}
+
+bool read_u32(const uint8_t** io_data, const uint8_t* end, uint32_t* out_value)
+{
+	const uint8_t* data = *io_data;
+	if (end - data < 4) { return false; }
+	*out_value = data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint32_t>(data[3]) << 24);
+	*io_data = data + 4;
+	return true;
+}
+
+void encode_pixels(const uint32_t* pixels, int count, std::vector<uint8_t>* out)
+{
+	int i = 0;
+	while (i < count) {
+		int run = 1;
+		while (i + run < count && run < kMaxRunLength && pixels[i + run] == pixels[i]) { ++run; }
+
+		if (run >= 2) {
+			out->push_back(static_cast<uint8_t>(run - 1));
+			append_u32(out, pixels[i]);
+			i += run;
+			continue;
+		}
+
+		// Literals until the next run of at least two equal pixels:
+		int literals = 1;
+		while (i + literals < count && literals < kMaxRunLength &&
+		       !(i + literals + 1 < count && pixels[i + literals] == pixels[i + literals + 1])) {
+			++literals;
+		}
+		out->push_back(static_cast<uint8_t>(0x80 | (literals - 1)));
+		for (int j = 0; j < literals; ++j) {
+			append_u32(out, pixels[i + j]);
+		}
+		i += literals;
+	}
+}
+
+bool decode_pixels(const uint8_t** io_data, const uint8_t* end, uint32_t* pixels, int count)
+{
+	int i = 0;
+	while (i < count) {
+		if (*io_data == end) { return false; }
+		const uint8_t n = *(*io_data)++;
+		const int length = (n & 0x7F) + 1;
+		if (i + length > count) { return false; }
+		if (n & 0x80) {
+			for (int j = 0; j < length; ++j) {
+				if (!read_u32(io_data, end, &pixels[i + j])) { return false; }
+			}
+		} else {
+			uint32_t value;
+			if (!read_u32(io_data, end, &value)) { return false; }
+			std::fill_n(pixels + i, length, value);
+		}
+		i += length;
+	}
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+// Used by SwOptions::frame_budget_ms
+
+const int kMaxQualityLevel = 2;
+const int kQualityCooldownFrames = 30; // Frames to wait before changing quality level again.
+
+struct AdaptiveQuality
+{
+	int    level = 0;
+	double smoothed_ms = 0;
+	int    frames_since_change = 0;
+
+	void update(double frame_ms, double budget_ms)
+	{
+		smoothed_ms = frames_since_change == 0 ? frame_ms : 0.8 * smoothed_ms + 0.2 * frame_ms;
+		frames_since_change += 1;
+		if (frames_since_change < kQualityCooldownFrames) { return; }
+
+		if (smoothed_ms > budget_ms && level < kMaxQualityLevel) {
+			level += 1;
+			frames_since_change = 0;
+		} else if (smoothed_ms < 0.5 * budget_ms && level > 0) {
+			level -= 1;
+			frames_since_change = 0;
+		}
+	}
+};
+
+// ----------------------------------------------------------------------------
+// Frame telemetry: the paint time and size of the last kTelemetryFrames frames.
+// Written by the painting thread, and readable from any other thread without locking:
+// the sequence number of a slot is odd while it is being written (a seqlock).
+
+const int kTelemetryFrames = 256;
+
+struct TelemetrySlot
+{
+	std::atomic<uint64_t> sequence; // 2 * frame once written.
+	std::atomic<float>    paint_ms;
+	std::atomic<int>      num_triangles;
+	std::atomic<int>      num_vertices;
+	std::atomic<int>      num_draw_lists;
+};
+
+TelemetrySlot         s_telemetry[kTelemetryFrames];
+std::atomic<uint64_t> s_telemetry_frames{0}; // Number of recorded frames.
+int                   s_telemetry_depth = 0; // Number of paint functions we are inside, so nested calls are one frame.
+float                 s_slow_frame_ms = 0;
+SlowFrameCallback     s_slow_frame_callback;
+
+void record_frame(float paint_ms, const ImDrawData* draw_data)
+{
+	const uint64_t frame = s_telemetry_frames.load(std::memory_order_relaxed) + 1;
+	TelemetrySlot& slot = s_telemetry[frame % kTelemetryFrames];
+
+	slot.sequence.store(2 * frame - 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	slot.paint_ms.store(paint_ms, std::memory_order_relaxed);
+	slot.num_triangles.store(draw_data->TotalIdxCount / 3, std::memory_order_relaxed);
+	slot.num_vertices.store(draw_data->TotalVtxCount, std::memory_order_relaxed);
+	slot.num_draw_lists.store(draw_data->CmdListsCount, std::memory_order_relaxed);
+	slot.sequence.store(2 * frame, std::memory_order_release);
+	s_telemetry_frames.store(frame, std::memory_order_release);
+
+	if (s_slow_frame_callback && paint_ms > s_slow_frame_ms) {
+		const SwFrameRecord record{frame, paint_ms, draw_data->TotalIdxCount / 3, draw_data->TotalVtxCount, draw_data->CmdListsCount};
+		s_telemetry_depth += 1; // Painting from within the callback should not count as frames.
+		s_slow_frame_callback(record);
+		s_telemetry_depth -= 1;
+	}
+}
+
+/// Returns false if the frame has been (or is being) overwritten by a newer one.
+bool read_frame(uint64_t frame, SwFrameRecord* out_record)
+{
+	const TelemetrySlot& slot = s_telemetry[frame % kTelemetryFrames];
+	if (slot.sequence.load(std::memory_order_acquire) != 2 * frame) { return false; }
+
+	out_record->frame          = frame;
+	out_record->paint_ms       = slot.paint_ms.load(std::memory_order_relaxed);
+	out_record->num_triangles  = slot.num_triangles.load(std::memory_order_relaxed);
+	out_record->num_vertices   = slot.num_vertices.load(std::memory_order_relaxed);
+	out_record->num_draw_lists = slot.num_draw_lists.load(std::memory_order_relaxed);
+
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return slot.sequence.load(std::memory_order_relaxed) == 2 * frame;
+}
+
+/// Put one at the top of each paint function. Records a frame when the outermost one ends.
+struct TelemetryScope
+{
+	std::chrono::steady_clock::time_point start_time;
+
+	TelemetryScope() : start_time(std::chrono::steady_clock::now())
+	{
+		s_telemetry_depth += 1;
+	}
+
+	~TelemetryScope()
+	{
+		s_telemetry_depth -= 1;
+		if (s_telemetry_depth > 0) { return; }
+		const std::chrono::duration<float, std::milli> duration = std::chrono::steady_clock::now() - start_time;
+		record_frame(duration.count(), ImGui::GetDrawData());
+	}
+};
+
+// ----------------------------------------------------------------------------
+// Compositing of a premultiplied UI layer onto YUV video (BT.601, limited range), used by paint_imgui_yuv.
+
+struct PremultipliedSum
+{
+	int r = 0, g = 0, b = 0, a = 0;
+
+	void add(uint32_t pixel)
+	{
+		r += (pixel >> IM_COL32_R_SHIFT) & 0xFF;
+		g += (pixel >> IM_COL32_G_SHIFT) & 0xFF;
+		b += (pixel >> IM_COL32_B_SHIFT) & 0xFF;
+		a += (pixel >> IM_COL32_A_SHIFT) & 0xFF;
+	}
+};
+
+uint8_t clamp_to_byte(int value)
+{
+	return static_cast<uint8_t>(std::min(std::max(value, 0), 255));
+}
+
+// Blend the layer color (premultiplied, averaged over n pixels) onto a video sample.
+uint8_t composite_luma(uint8_t video, const PremultipliedSum& layer)
+{
+	const int layer_luma = ((66 * layer.r + 129 * layer.g + 25 * layer.b + 128) >> 8) + 16 * layer.a / 255;
+	return clamp_to_byte(video * (255 - layer.a) / 255 + layer_luma);
+}
+
+void composite_chroma(uint8_t* u, uint8_t* v, const PremultipliedSum& layer, int n)
+{
+	const int a = layer.a / n;
+	const int layer_u = ((-38 * layer.r - 74 * layer.g + 112 * layer.b) / 256 + 128 * layer.a / 255) / n;
+	const int layer_v = ((112 * layer.r - 94 * layer.g - 18 * layer.b) / 256 + 128 * layer.a / 255) / n;
+	*u = clamp_to_byte(*u * (255 - a) / 255 + layer_u);
+	*v = clamp_to_byte(*v * (255 - a) / 255 + layer_v);
+}
+
+// Composite rows [min_y, min_y + num_rows) of the frame, where min_y is even.
+void composite_yuv(const SwYuvFrame& frame, const uint32_t* layer, int min_y, int num_rows)
+{
+	const uint32_t alpha_mask = 0xFFu << IM_COL32_A_SHIFT;
+
+	for (int y = min_y; y < min_y + num_rows; y += 2) {
+		const uint32_t* rows[2] = { layer + (y - min_y) * frame.width, layer + (y + 1 - min_y) * frame.width };
+		const int rows_in_block = (y + 1 < min_y + num_rows) ? 2 : 1;
+
+		for (int x = 0; x < frame.width; x += 2) {
+			const int columns_in_block = (x + 1 < frame.width) ? 2 : 1;
+
+			// Fast path for the common case of no UI on top of the video:
+			bool has_ui = false;
+			for (int dy = 0; dy < rows_in_block; ++dy) {
+				for (int dx = 0; dx < columns_in_block; ++dx) {
+					has_ui |= (rows[dy][x + dx] & alpha_mask) != 0;
+				}
+			}
+			if (!has_ui) { continue; }
+
+			PremultipliedSum block;
+			for (int dy = 0; dy < rows_in_block; ++dy) {
+				for (int dx = 0; dx < columns_in_block; ++dx) {
+					PremultipliedSum pixel;
+					pixel.add(rows[dy][x + dx]);
+					block.add(rows[dy][x + dx]);
+					uint8_t& luma = frame.y[(y + dy) * frame.y_stride + x + dx];
+					luma = composite_luma(luma, pixel);
+				}
+			}
+
+			const int n = rows_in_block * columns_in_block;
+			uint8_t* chroma_row = frame.u + (y / 2) * frame.uv_stride;
+			if (frame.format == SwYuvFormat::NV12) {
+				composite_chroma(&chroma_row[x], &chroma_row[x + 1], block, n);
+			} else {
+				composite_chroma(&chroma_row[x / 2], &frame.v[(y / 2) * frame.uv_stride + x / 2], block, n);
+			}
+		}
+	}
+}
+
 } // namespace
 
 void make_style_fast()
@@ -687,24 +1919,590 @@ void bind_imgui_painting()
 }
 
 static Stats s_stats; // TODO: pass as an argument?
+static TextRun s_text_run; // Reused between frames to avoid allocations.
 
-void paint_imgui(uint32_t* pixels, int width_pixels, int height_pixels, const SwOptions& options)
+// One set of caches per nesting level of draw callbacks (painting from within one),
+// so a nested paint does not overwrite the vertices of the draw list being painted.
+// Each set has kMaxPaintTargets caches per draw list.
+static std::vector<std::vector<VertexCache>> s_vertex_caches;
+static uint64_t s_vertex_generation = 0; // Bumped once per painted frame.
+
+static VertexCache* vertex_caches(int draw_list_index)
+{
+	const size_t depth = static_cast<size_t>(s_draw_callback_depth);
+	if (s_vertex_caches.size() <= depth) { s_vertex_caches.resize(depth + 1); }
+	std::vector<VertexCache>& caches = s_vertex_caches[depth];
+	const size_t needed = static_cast<size_t>(draw_list_index + 1) * kMaxPaintTargets;
+	if (caches.size() < needed) { caches.resize(needed); }
+	return &caches[draw_list_index * kMaxPaintTargets];
+}
+
+// Used by paint_imgui_encoded:
+static std::vector<uint8_t>  s_damage;
+static std::vector<uint8_t>  s_previous_damage;
+static std::vector<uint32_t> s_previous_frame;
+static int                   s_previous_width = 0;
+static int                   s_previous_height = 0;
+
+// Used by SwOptions::record_overdraw:
+static std::vector<uint16_t> s_overdraw;
+static int                   s_overdraw_width = 0;
+static int                   s_overdraw_height = 0;
+
+static uint16_t* begin_overdraw(int width_pixels, int height_pixels)
+{
+	s_overdraw.assign(width_pixels * height_pixels, 0);
+	s_overdraw_width = width_pixels;
+	s_overdraw_height = height_pixels;
+	return s_overdraw.data();
+}
+
+static void paint_frame(
+	uint32_t*        pixels,
+	int              width_pixels,
+	int              height_pixels,
+	int              stride,
+	uint8_t*         damage,
+	const SwOptions& options)
 {
 	const float width_points = ImGui::GetIO().DisplaySize.x;
 	const float height_points = ImGui::GetIO().DisplaySize.y;
 	const ImVec2 scale{width_pixels / width_points, height_pixels / height_points};
-	PaintTarget target{pixels, width_pixels, height_pixels, scale};
+	const int width_tiles = (width_pixels + kTileSize - 1) / kTileSize;
+	PaintTarget target{pixels, width_pixels, height_pixels, stride, scale, width_tiles, 0, height_pixels, damage, nullptr, false};
 	const ImDrawData* draw_data = ImGui::GetDrawData();
 
+	if (options.record_overdraw) {
+		target.overdraw = begin_overdraw(width_pixels, height_pixels);
+	} else {
+		s_overdraw.clear();
+	}
+
 	s_stats = Stats{};
+	s_vertex_generation += 1;
 	for (int i = 0; i < draw_data->CmdListsCount; ++i) {
-		paint_draw_list(target, draw_data->CmdLists[i], options, &s_stats);
+		paint_draw_list(&target, 1, draw_data->CmdLists[i], vertex_caches(i), s_vertex_generation, options, &s_text_run,
+		                options.collect_stats ? &s_stats : nullptr);
+	}
+}
+
+static AdaptiveQuality s_quality;
+static std::vector<uint32_t> s_half_resolution_pixels;
+static std::vector<uint8_t>  s_half_resolution_tiles; // The tiles that go through s_half_resolution_pixels.
+
+/// Paint at half resolution and upscale with nearest neighbor.
+/// Only the tiles that the draw data can touch are downscaled and upscaled,
+/// so whatever the caller painted elsewhere keeps its full resolution.
+static void paint_half_resolution(uint32_t* pixels, int width_pixels, int height_pixels, int stride, const SwOptions& options)
+{
+	const int half_width = (width_pixels + 1) / 2;
+	const int half_height = (height_pixels + 1) / 2;
+	s_half_resolution_pixels.resize(half_width * half_height);
+
+	const float width_points = ImGui::GetIO().DisplaySize.x;
+	const float height_points = ImGui::GetIO().DisplaySize.y;
+	const ImVec2 scale{width_pixels / width_points, height_pixels / height_points};
+	const int width_tiles = (width_pixels + kTileSize - 1) / kTileSize;
+	const int height_tiles = (height_pixels + kTileSize - 1) / kTileSize;
+	const PaintTarget target{pixels, width_pixels, height_pixels, stride, scale, width_tiles, 0, height_pixels, nullptr, nullptr, false};
+	s_half_resolution_tiles.assign(width_tiles * height_tiles, 0);
+	mark_covered_tiles(target, ImGui::GetDrawData(), s_half_resolution_tiles.data());
+
+	// A tile is kTileSize / 2 pixels wide at half resolution. The other half resolution pixels are never painted.
+	const int half_tile = kTileSize / 2;
+	for (int tile_y = 0; tile_y < height_tiles; ++tile_y) {
+		for (int tile_x = 0; tile_x < width_tiles; ++tile_x) {
+			if (!s_half_resolution_tiles[tile_y * width_tiles + tile_x]) { continue; }
+			const int end_y = std::min((tile_y + 1) * half_tile, half_height);
+			const int end_x = std::min((tile_x + 1) * half_tile, half_width);
+			for (int y = tile_y * half_tile; y < end_y; ++y) {
+				for (int x = tile_x * half_tile; x < end_x; ++x) {
+					s_half_resolution_pixels[y * half_width + x] = pixels[2 * y * stride + 2 * x];
+				}
+			}
+		}
+	}
+
+	paint_frame(s_half_resolution_pixels.data(), half_width, half_height, half_width, nullptr, options);
+
+	for (int tile_y = 0; tile_y < height_tiles; ++tile_y) {
+		for (int tile_x = 0; tile_x < width_tiles; ++tile_x) {
+			if (!s_half_resolution_tiles[tile_y * width_tiles + tile_x]) { continue; }
+			const int end_y = std::min((tile_y + 1) * kTileSize, height_pixels);
+			const int end_x = std::min((tile_x + 1) * kTileSize, width_pixels);
+			for (int y = tile_y * kTileSize; y < end_y; ++y) {
+				const uint32_t* half_row = s_half_resolution_pixels.data() + (y / 2) * half_width;
+				uint32_t* row = pixels + y * stride;
+				for (int x = tile_x * kTileSize; x < end_x; ++x) {
+					row[x] = half_row[x / 2];
+				}
+			}
+		}
+	}
+}
+
+/// Number of pixels between the starts of two rows of the buffer.
+static int stride_pixels(const SwPixelBuffer& buffer)
+{
+	if (buffer.pitch_bytes == 0) { return buffer.width_pixels; }
+	assert(buffer.pitch_bytes % sizeof(uint32_t) == 0);
+	return buffer.pitch_bytes / static_cast<int>(sizeof(uint32_t));
+}
+
+void paint_imgui(uint32_t* pixels, int width_pixels, int height_pixels, const SwOptions& options)
+{
+	paint_imgui(SwPixelBuffer{pixels, width_pixels, height_pixels, 0, 0, 0}, options);
+}
+
+void paint_imgui(const SwPixelBuffer& buffer, const SwOptions& options)
+{
+	const TelemetryScope telemetry;
+	assert(buffer.pixels);
+	const int stride = stride_pixels(buffer);
+	assert(buffer.origin_x >= 0 && buffer.origin_y >= 0 && buffer.origin_x + buffer.width_pixels <= stride);
+	uint32_t* pixels = buffer.pixels + buffer.origin_y * stride + buffer.origin_x;
+	const int width_pixels = buffer.width_pixels;
+	const int height_pixels = buffer.height_pixels;
+
+	if (options.frame_budget_ms <= 0) {
+		s_quality = AdaptiveQuality{};
+		paint_frame(pixels, width_pixels, height_pixels, stride, nullptr, options);
+		return;
+	}
+
+	const auto start_time = std::chrono::steady_clock::now();
+
+	SwOptions adapted_options = options;
+	adapted_options.skip_aa_fringes |= s_quality.level >= 1;
+
+	if (s_quality.level >= 2) {
+		paint_half_resolution(pixels, width_pixels, height_pixels, stride, adapted_options);
+	} else {
+		paint_frame(pixels, width_pixels, height_pixels, stride, nullptr, adapted_options);
+	}
+
+	const std::chrono::duration<double, std::milli> duration = std::chrono::steady_clock::now() - start_time;
+	s_quality.update(duration.count(), options.frame_budget_ms);
+}
+
+int quality_level()
+{
+	return s_quality.level;
+}
+
+/// See paint_imgui_bands. If layer is true, the bands are painted as transparent layers (see PaintTarget::layer).
+static void paint_bands(
+	uint32_t*           band_pixels,
+	int                 width_pixels,
+	int                 height_pixels,
+	int                 band_rows,
+	uint32_t            clear_color,
+	bool                layer,
+	const BandCallback& on_band,
+	const SwOptions&    options)
+{
+	assert(band_pixels);
+	assert(band_rows > 0);
+
+	const float width_points = ImGui::GetIO().DisplaySize.x;
+	const float height_points = ImGui::GetIO().DisplaySize.y;
+	const ImVec2 scale{width_pixels / width_points, height_pixels / height_points};
+	const int width_tiles = (width_pixels + kTileSize - 1) / kTileSize;
+	const ImDrawData* draw_data = ImGui::GetDrawData();
+	uint16_t* overdraw = nullptr;
+	if (options.record_overdraw) {
+		overdraw = begin_overdraw(width_pixels, height_pixels);
+	} else {
+		s_overdraw.clear();
+	}
+
+	s_stats = Stats{};
+	s_vertex_generation += 1; // All bands use the same transformed vertices.
+	for (int band_y = 0; band_y < height_pixels; band_y += band_rows) {
+		const int num_rows = std::min(band_rows, height_pixels - band_y);
+		std::fill_n(band_pixels, width_pixels * num_rows, clear_color);
+
+		const PaintTarget target{band_pixels, width_pixels, height_pixels, width_pixels, scale, width_tiles, band_y, band_y + num_rows, nullptr, overdraw, layer};
+		for (int i = 0; i < draw_data->CmdListsCount; ++i) {
+			paint_draw_list(&target, 1, draw_data->CmdLists[i], vertex_caches(i), s_vertex_generation, options, &s_text_run,
+			                options.collect_stats ? &s_stats : nullptr);
+		}
+
+		on_band(band_pixels, band_y, num_rows);
+	}
+}
+
+void paint_imgui_bands(
+	uint32_t*           band_pixels,
+	int                 width_pixels,
+	int                 height_pixels,
+	int                 band_rows,
+	uint32_t            clear_color,
+	const BandCallback& on_band,
+	const SwOptions&    options)
+{
+	const TelemetryScope telemetry;
+	paint_bands(band_pixels, width_pixels, height_pixels, band_rows, clear_color, false, on_band, options);
+}
+
+static SwRect rect_union(const SwRect& a, const SwRect& b)
+{
+	if (a.min_x >= a.max_x || a.min_y >= a.max_y) { return b; }
+	if (b.min_x >= b.max_x || b.min_y >= b.max_y) { return a; }
+	return SwRect{std::min(a.min_x, b.min_x), std::min(a.min_y, b.min_y),
+	              std::max(a.max_x, b.max_x), std::max(a.max_y, b.max_y)};
+}
+
+// Used by paint_imgui_damaged:
+static std::vector<uint8_t> s_painted_tiles;
+static SwRect               s_previous_painted_rect{0, 0, 0, 0};
+static int                  s_previous_damaged_width = 0;
+static int                  s_previous_damaged_height = 0;
+
+SwRect paint_imgui_damaged(uint32_t* pixels, int width_pixels, int height_pixels, const SwOptions& options)
+{
+	const TelemetryScope telemetry;
+	const int width_tiles = (width_pixels + kTileSize - 1) / kTileSize;
+	const int height_tiles = (height_pixels + kTileSize - 1) / kTileSize;
+
+	s_painted_tiles.assign(width_tiles * height_tiles, 0);
+	paint_frame(pixels, width_pixels, height_pixels, width_pixels, s_painted_tiles.data(), options);
+
+	SwRect painted{0, 0, 0, 0};
+	for (int ty = 0; ty < height_tiles; ++ty) {
+		for (int tx = 0; tx < width_tiles; ++tx) {
+			if (!s_painted_tiles[ty * width_tiles + tx]) { continue; }
+			const SwRect tile{tx * kTileSize, ty * kTileSize,
+			                  std::min((tx + 1) * kTileSize, width_pixels), std::min((ty + 1) * kTileSize, height_pixels)};
+			painted = rect_union(painted, tile);
+		}
+	}
+
+	SwRect damaged = rect_union(painted, s_previous_painted_rect);
+	if (width_pixels != s_previous_damaged_width || height_pixels != s_previous_damaged_height) {
+		damaged = SwRect{0, 0, width_pixels, height_pixels};
+		s_previous_damaged_width = width_pixels;
+		s_previous_damaged_height = height_pixels;
+	}
+	s_previous_painted_rect = painted;
+	return damaged;
+}
+
+/// Shrink source to target by averaging the source pixels covering each target pixel.
+static void box_downsample(
+	const uint32_t* source, int source_width, int source_height,
+	uint32_t*       target, int target_width, int target_height)
+{
+	for (int y = 0; y < target_height; ++y) {
+		const int source_min_y = y * source_height / target_height;
+		const int source_max_y = std::max((y + 1) * source_height / target_height, source_min_y + 1);
+
+		for (int x = 0; x < target_width; ++x) {
+			const int source_min_x = x * source_width / target_width;
+			const int source_max_x = std::max((x + 1) * source_width / target_width, source_min_x + 1);
+
+			// Works for any channel order, since all four channels are treated the same:
+			uint64_t sum[4] = {0, 0, 0, 0};
+			for (int sy = source_min_y; sy < source_max_y; ++sy) {
+				const uint32_t* row = source + sy * source_width;
+				for (int sx = source_min_x; sx < source_max_x; ++sx) {
+					sum[0] += (row[sx] >>  0) & 0xFFu;
+					sum[1] += (row[sx] >>  8) & 0xFFu;
+					sum[2] += (row[sx] >> 16) & 0xFFu;
+					sum[3] += (row[sx] >> 24) & 0xFFu;
+				}
+			}
+
+			const uint64_t count = (source_max_x - source_min_x) * (source_max_y - source_min_y);
+			uint32_t result = 0;
+			for (int c = 0; c < 4; ++c) {
+				result |= static_cast<uint32_t>((sum[c] + count / 2) / count) << (8 * c);
+			}
+			target[y * target_width + x] = result;
+		}
+	}
+}
+
+void paint_imgui_multi(const SwTarget* targets, int num_targets, const SwOptions& options)
+{
+	const TelemetryScope telemetry;
+	assert(targets && num_targets > 0);
+	assert(!targets[0].downsample);
+	if (!targets || num_targets <= 0 || targets[0].downsample) { return; }
+
+	const float width_points = ImGui::GetIO().DisplaySize.x;
+	const float height_points = ImGui::GetIO().DisplaySize.y;
+	const ImDrawData* draw_data = ImGui::GetDrawData();
+
+	if (!options.record_overdraw) { s_overdraw.clear(); }
+	s_stats = Stats{};
+
+	// Each pass over the draw data paints at most kMaxPaintTargets targets.
+	// Stats and overdraw come from the first pass, which starts with targets[0].
+	int next_target = 0;
+	for (bool first_pass = true; ; first_pass = false) {
+		PaintTarget paint_targets[kMaxPaintTargets];
+		int num_paint_targets = 0;
+		for (; next_target < num_targets && num_paint_targets < kMaxPaintTargets; ++next_target) {
+			const SwTarget& target = targets[next_target];
+			if (target.downsample) { continue; }
+			const ImVec2 scale{target.width_pixels / width_points, target.height_pixels / height_points};
+			const int width_tiles = (target.width_pixels + kTileSize - 1) / kTileSize;
+			paint_targets[num_paint_targets++] = PaintTarget{target.pixels, target.width_pixels, target.height_pixels,
+				target.width_pixels, scale, width_tiles, 0, target.height_pixels, nullptr, nullptr, false};
+		}
+		if (num_paint_targets == 0) { break; }
+
+		if (first_pass && options.record_overdraw) {
+			paint_targets[0].overdraw = begin_overdraw(targets[0].width_pixels, targets[0].height_pixels);
+		}
+
+		s_vertex_generation += 1; // The vertex caches are per target slot, and the slots now hold other targets.
+		for (int i = 0; i < draw_data->CmdListsCount; ++i) {
+			paint_draw_list(paint_targets, num_paint_targets, draw_data->CmdLists[i], vertex_caches(i), s_vertex_generation,
+			                options, &s_text_run, first_pass && options.collect_stats ? &s_stats : nullptr);
+		}
+	}
+
+	for (int i = 0; i < num_targets; ++i) {
+		const SwTarget& target = targets[i];
+		if (!target.downsample) { continue; }
+		box_downsample(targets[0].pixels, targets[0].width_pixels, targets[0].height_pixels,
+		               target.pixels, target.width_pixels, target.height_pixels);
+	}
+}
+
+static std::vector<uint32_t> s_yuv_band_pixels;
+
+void paint_imgui_yuv(const SwYuvFrame& frame, const SwOptions& options)
+{
+	const TelemetryScope telemetry;
+	assert(frame.y && frame.u);
+	assert(frame.format == SwYuvFormat::NV12 || frame.v);
+
+	const int band_rows = kTileSize; // Must be even.
+	s_yuv_band_pixels.resize(frame.width * band_rows);
+
+	// Paint onto a transparent layer, which is then blended onto the video one band at a time.
+	const uint32_t transparent = 0;
+	paint_bands(s_yuv_band_pixels.data(), frame.width, frame.height, band_rows, transparent, true,
+		[&](const uint32_t* band_pixels, int band_y, int num_rows) {
+			composite_yuv(frame, band_pixels, band_y, num_rows);
+		}, options);
+}
+
+void paint_imgui_encoded(
+	uint32_t*             pixels,
+	int                   width_pixels,
+	int                   height_pixels,
+	std::vector<uint8_t>* out_encoded,
+	bool                  keyframe,
+	const SwOptions&      options)
+{
+	const TelemetryScope telemetry;
+	assert(out_encoded);
+
+	const int width_tiles = (width_pixels + kTileSize - 1) / kTileSize;
+	const int height_tiles = (height_pixels + kTileSize - 1) / kTileSize;
+	const int num_tiles = width_tiles * height_tiles;
+
+	if (width_pixels != s_previous_width || height_pixels != s_previous_height) {
+		keyframe = true;
+		s_previous_frame.assign(width_pixels * height_pixels, 0);
+		s_previous_damage.assign(num_tiles, 0);
+		s_previous_width = width_pixels;
+		s_previous_height = height_pixels;
+	}
+
+	s_damage.assign(num_tiles, 0);
+	paint_frame(pixels, width_pixels, height_pixels, width_pixels, s_damage.data(), options);
+
+	out_encoded->clear();
+	append_u32(out_encoded, kFrameMagic);
+	append_u32(out_encoded, width_pixels);
+	append_u32(out_encoded, height_pixels);
+	const size_t num_tiles_offset = out_encoded->size();
+	append_u32(out_encoded, 0);
+
+	uint32_t num_encoded_tiles = 0;
+	uint32_t tile_pixels[kTileSize * kTileSize];
+
+	for (int tile_index = 0; tile_index < num_tiles; ++tile_index) {
+		// A tile painted last frame but not this one may have been cleared by the caller:
+		if (!keyframe && !s_damage[tile_index] && !s_previous_damage[tile_index]) { continue; }
+
+		const int min_x = (tile_index % width_tiles) * kTileSize;
+		const int min_y = (tile_index / width_tiles) * kTileSize;
+		const int tile_width = std::min(kTileSize, width_pixels - min_x);
+		const int tile_height = std::min(kTileSize, height_pixels - min_y);
+
+		bool changed = keyframe;
+		for (int y = 0; y < tile_height; ++y) {
+			const size_t offset = (min_y + y) * width_pixels + min_x;
+			uint32_t* previous_row = s_previous_frame.data() + offset;
+			changed |= std::memcmp(previous_row, pixels + offset, tile_width * sizeof(uint32_t)) != 0;
+			std::memcpy(previous_row, pixels + offset, tile_width * sizeof(uint32_t));
+			std::memcpy(tile_pixels + y * tile_width, pixels + offset, tile_width * sizeof(uint32_t));
+		}
+		if (!changed) { continue; }
+
+		append_u32(out_encoded, tile_index);
+		encode_pixels(tile_pixels, tile_width * tile_height, out_encoded);
+		num_encoded_tiles += 1;
+	}
+
+	for (int i = 0; i < 4; ++i) {
+		(*out_encoded)[num_tiles_offset + i] = static_cast<uint8_t>(num_encoded_tiles >> (8 * i));
+	}
+
+	s_previous_damage.swap(s_damage);
+}
+
+bool decode_frame(const uint8_t* data, size_t size, uint32_t* pixels, int width_pixels, int height_pixels)
+{
+	const uint8_t* end = data + size;
+	uint32_t magic, width, height, num_encoded_tiles;
+	if (!read_u32(&data, end, &magic) || magic != kFrameMagic) { return false; }
+	if (!read_u32(&data, end, &width) || width != static_cast<uint32_t>(width_pixels)) { return false; }
+	if (!read_u32(&data, end, &height) || height != static_cast<uint32_t>(height_pixels)) { return false; }
+	if (!read_u32(&data, end, &num_encoded_tiles)) { return false; }
+
+	const int width_tiles = (width_pixels + kTileSize - 1) / kTileSize;
+	const int height_tiles = (height_pixels + kTileSize - 1) / kTileSize;
+	uint32_t tile_pixels[kTileSize * kTileSize];
+
+	for (uint32_t i = 0; i < num_encoded_tiles; ++i) {
+		uint32_t tile_index;
+		if (!read_u32(&data, end, &tile_index)) { return false; }
+		if (tile_index >= static_cast<uint32_t>(width_tiles * height_tiles)) { return false; }
+
+		const int min_x = (tile_index % width_tiles) * kTileSize;
+		const int min_y = (tile_index / width_tiles) * kTileSize;
+		const int tile_width = std::min(kTileSize, width_pixels - min_x);
+		const int tile_height = std::min(kTileSize, height_pixels - min_y);
+
+		if (!decode_pixels(&data, end, tile_pixels, tile_width * tile_height)) { return false; }
+		for (int y = 0; y < tile_height; ++y) {
+			std::memcpy(pixels + (min_y + y) * width_pixels + min_x, tile_pixels + y * tile_width,
+			            tile_width * sizeof(uint32_t));
+		}
+	}
+	return data == end;
+}
+
+int recent_frames(SwFrameRecord* out_frames, int max_frames)
+{
+	assert(out_frames || max_frames == 0);
+	const uint64_t last_frame = s_telemetry_frames.load(std::memory_order_acquire);
+	const uint64_t num_frames = std::min<uint64_t>({last_frame, static_cast<uint64_t>(max_frames), kTelemetryFrames});
+
+	int num_read = 0;
+	for (uint64_t frame = last_frame - num_frames + 1; frame <= last_frame; ++frame) {
+		if (read_frame(frame, &out_frames[num_read])) { num_read += 1; }
+	}
+	return num_read;
+}
+
+SwFrameTimeSummary frame_time_summary()
+{
+	SwFrameRecord frames[kTelemetryFrames];
+	const int num_frames = recent_frames(frames, kTelemetryFrames);
+
+	SwFrameTimeSummary summary{num_frames, 0, 0, 0, 0};
+	if (num_frames == 0) { return summary; }
+
+	float times[kTelemetryFrames];
+	for (int i = 0; i < num_frames; ++i) { times[i] = frames[i].paint_ms; }
+	std::sort(times, times + num_frames);
+
+	// Nearest rank:
+	const auto percentile = [&](int p) {
+		return times[std::max(0, (p * num_frames + 99) / 100 - 1)];
+	};
+	summary.p50_ms = percentile(50);
+	summary.p95_ms = percentile(95);
+	summary.p99_ms = percentile(99);
+	summary.max_ms = times[num_frames - 1];
+	return summary;
+}
+
+SwFrameTimeHistogram frame_time_histogram()
+{
+	// Roughly doubling, with the frame times of 60, 30 and 20 Hz as edges:
+	const float bucket_max_ms[SwFrameTimeHistogram::kNumBuckets] = {0.5f, 1, 2, 4, 8, 16.7f, 33.3f, 50, 100, FLT_MAX};
+
+	SwFrameRecord frames[kTelemetryFrames];
+	const int num_frames = recent_frames(frames, kTelemetryFrames);
+
+	SwFrameTimeHistogram histogram;
+	histogram.num_frames = num_frames;
+	for (int b = 0; b < SwFrameTimeHistogram::kNumBuckets; ++b) {
+		histogram.bucket_max_ms[b] = bucket_max_ms[b];
+		histogram.counts[b] = 0;
+	}
+	for (int i = 0; i < num_frames; ++i) {
+		int b = 0;
+		while (frames[i].paint_ms > bucket_max_ms[b] && b + 1 < SwFrameTimeHistogram::kNumBuckets) { b += 1; }
+		histogram.counts[b] += 1;
+	}
+	return histogram;
+}
+
+void set_slow_frame_callback(float threshold_ms, SlowFrameCallback callback)
+{
+	s_slow_frame_ms = threshold_ms;
+	s_slow_frame_callback = std::move(callback);
+}
+
+const SwPaintContext* current_paint_context()
+{
+	return s_paint_context;
+}
+
+const uint16_t* overdraw_counts(int* out_width, int* out_height)
+{
+	if (s_overdraw.empty()) { return nullptr; }
+	if (out_width) { *out_width = s_overdraw_width; }
+	if (out_height) { *out_height = s_overdraw_height; }
+	return s_overdraw.data();
+}
+
+void paint_overdraw_heatmap(uint32_t* pixels, int width_pixels, int height_pixels)
+{
+	paint_overdraw_heatmap(SwPixelBuffer{pixels, width_pixels, height_pixels, 0, 0, 0});
+}
+
+void paint_overdraw_heatmap(const SwPixelBuffer& buffer)
+{
+	const int width_pixels = buffer.width_pixels;
+	const int height_pixels = buffer.height_pixels;
+	if (s_overdraw_width != width_pixels || s_overdraw_height != height_pixels) { return; }
+	const int stride = stride_pixels(buffer);
+
+	// Painted once is blue, then green, yellow, orange, and red for five times or more:
+	const ColorInt palette[] = {
+		ColorInt(IM_COL32(  0,   0, 255, 128)),
+		ColorInt(IM_COL32(  0, 255,   0, 128)),
+		ColorInt(IM_COL32(255, 255,   0, 160)),
+		ColorInt(IM_COL32(255, 128,   0, 192)),
+		ColorInt(IM_COL32(255,   0,   0, 224)),
+	};
+	const int palette_size = sizeof(palette) / sizeof(palette[0]);
+
+	for (int y = 0; y < height_pixels; ++y) {
+		uint32_t* row = buffer.pixels + (buffer.origin_y + y) * stride + buffer.origin_x;
+		for (int x = 0; x < width_pixels; ++x) {
+			const int count = s_overdraw[y * width_pixels + x];
+			if (count == 0) { continue; }
+			row[x] = blend(ColorInt(row[x]), palette[std::min(count, palette_size) - 1]).toUint32();
+		}
 	}
 }
 
 void unbind_imgui_painting()
 {
 	ImGuiIO& io = ImGui::GetIO();
+	free_scaled_textures();
 	delete reinterpret_cast<Texture*>(io.Fonts->TexID);
 	io.Fonts = nullptr;
 }
@@ -715,11 +2513,17 @@ bool show_options(SwOptions* io_options)
 	bool changed = false;
 	changed |= ImGui::Checkbox("optimize_text", &io_options->optimize_text);
 	changed |= ImGui::Checkbox("optimize_rectangles", &io_options->optimize_rectangles);
+	changed |= ImGui::Checkbox("batch_text", &io_options->batch_text);
+	changed |= ImGui::Checkbox("skip_aa_fringes", &io_options->skip_aa_fringes);
+	changed |= ImGui::Checkbox("collect_stats", &io_options->collect_stats);
+	changed |= ImGui::Checkbox("record_overdraw", &io_options->record_overdraw);
+	changed |= ImGui::SliderFloat("frame_budget_ms", &io_options->frame_budget_ms, 0.0f, 50.0f, "%.1f ms");
 	return changed;
 }
 
 void show_stats()
 {
+	ImGui::Text("quality_level:                      %7d",   s_quality.level);
 	ImGui::Text("uniform_triangle_pixels:            %7d",   s_stats.uniform_triangle_pixels);
 	ImGui::Text("textured_triangle_pixels:           %7d",   s_stats.textured_triangle_pixels);
 	ImGui::Text("gradient_triangle_pixels:           %7d",   s_stats.gradient_triangle_pixels);
@@ -728,6 +2532,66 @@ void show_stats()
 	ImGui::Text("textured_rectangle_pixels:          %7.0f", s_stats.textured_rectangle_pixels);
 	ImGui::Text("gradient_rectangle_pixels:          %7.0f", s_stats.gradient_rectangle_pixels);
 	ImGui::Text("gradient_textured_rectangle_pixels: %7.0f", s_stats.gradient_textured_rectangle_pixels);
+
+	SwFrameRecord frames[kTelemetryFrames];
+	const int num_frames = recent_frames(frames, kTelemetryFrames);
+	if (num_frames > 0) {
+		const SwFrameTimeSummary summary = frame_time_summary();
+		ImGui::Text("paint ms p50 / p95 / p99 / max:     %.2f / %.2f / %.2f / %.2f",
+		            summary.p50_ms, summary.p95_ms, summary.p99_ms, summary.max_ms);
+
+		float times[kTelemetryFrames];
+		for (int i = 0; i < num_frames; ++i) { times[i] = frames[i].paint_ms; }
+		ImGui::PlotLines("##paint_ms", times, num_frames, 0, "paint ms, last frames", 0.0f, summary.max_ms, ImVec2(0, 60));
+
+		const SwFrameTimeHistogram histogram = frame_time_histogram();
+		float counts[SwFrameTimeHistogram::kNumBuckets];
+		for (int b = 0; b < SwFrameTimeHistogram::kNumBuckets; ++b) { counts[b] = static_cast<float>(histogram.counts[b]); }
+		ImGui::PlotHistogram("##paint_ms_histogram", counts, SwFrameTimeHistogram::kNumBuckets, 0,
+		                     "frames per paint ms bucket", 0.0f, FLT_MAX, ImVec2(0, 60));
+		char edges[128] = "bucket max ms:";
+		for (int b = 0; b + 1 < SwFrameTimeHistogram::kNumBuckets; ++b) {
+			const size_t length = std::strlen(edges);
+			std::snprintf(edges + length, sizeof(edges) - length, " %g", histogram.bucket_max_ms[b]);
+		}
+		ImGui::Text("%s, inf", edges);
+	}
+
+	if (s_overdraw.empty()) { return; }
+
+	// Summarize the overdraw, per pixel and per tile:
+	const int width_tiles = (s_overdraw_width + kTileSize - 1) / kTileSize;
+	const int height_tiles = (s_overdraw_height + kTileSize - 1) / kTileSize;
+	std::vector<int> tile_counts(width_tiles * height_tiles, 0);
+	double total_count = 0;
+	int painted_pixels = 0;
+	int max_count = 0;
+
+	for (int y = 0; y < s_overdraw_height; ++y) {
+		for (int x = 0; x < s_overdraw_width; ++x) {
+			const int count = s_overdraw[y * s_overdraw_width + x];
+			total_count += count;
+			painted_pixels += count > 0 ? 1 : 0;
+			max_count = std::max(max_count, count);
+			tile_counts[(y / kTileSize) * width_tiles + x / kTileSize] += count;
+		}
+	}
+
+	ImGui::Text("overdraw per pixel:                 %7.2f", total_count / s_overdraw.size());
+	ImGui::Text("overdraw per painted pixel:         %7.2f", painted_pixels ? total_count / painted_pixels : 0.0);
+	ImGui::Text("max overdraw:                       %7d",   max_count);
+
+	std::vector<int> hottest(tile_counts.size());
+	for (size_t i = 0; i < hottest.size(); ++i) { hottest[i] = static_cast<int>(i); }
+	const size_t num_hottest = std::min<size_t>(5, hottest.size());
+	std::partial_sort(hottest.begin(), hottest.begin() + num_hottest, hottest.end(),
+		[&](int a, int b) { return tile_counts[a] > tile_counts[b]; });
+
+	for (size_t i = 0; i < num_hottest; ++i) {
+		const int tile = hottest[i];
+		ImGui::Text("hot tile at (%4d, %4d):            %7.2f", (tile % width_tiles) * kTileSize, (tile / width_tiles) * kTileSize,
+		            static_cast<double>(tile_counts[tile]) / (kTileSize * kTileSize));
+	}
 }
 
 } // namespace imgui_sw
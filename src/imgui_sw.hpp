@@ -12,7 +12,10 @@
 //   * It does not support painting with any other texture than the default font texture.
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
+#include <functional>
+#include <vector>
 
 namespace imgui_sw {
 
@@ -20,6 +23,89 @@ struct SwOptions
 {
 	bool optimize_text = true;  // No reason to turn this off.
 	bool optimize_rectangles = true; // No reason to turn this off.
+	bool batch_text = true; // Paint glyphs sharing a baseline one row at a time. Requires optimize_text.
+	bool skip_aa_fringes = false; // Skip the thin fading triangles ImGui adds around filled shapes for anti-aliasing. Faster, but jaggy. Thin lines are kept.
+	bool collect_stats = true; // Count painted pixels for show_stats. Slightly faster if off.
+	bool record_overdraw = false; // Count how many times each pixel is painted. See overdraw_counts.
+
+	/// If positive, paint_imgui lowers the quality when painting takes longer than this,
+	/// and raises it again when there is time to spare. See quality_level().
+	float frame_budget_ms = 0;
+};
+
+enum class SwPixelFormat
+{
+	ABGR, // ImGui default: R in the lowest byte.
+	ARGB, // IMGUI_USE_BGRA_PACKED_COLOR: B in the lowest byte.
+};
+
+/// Describes the pixels being painted, so that ImGui draw callbacks can paint directly into them.
+struct SwPaintContext
+{
+	uint32_t*     pixels;     // Use pixel(x, y) to find a pixel.
+	int           width;      // Of the whole frame, in pixels.
+	int           height;     // Of the whole frame, in pixels.
+	int           stride;     // Number of pixels between the starts of two rows.
+	int           band_min_y; // Only rows [band_min_y, band_max_y) are in pixels. See paint_imgui_bands.
+	int           band_max_y;
+	float         scale_x;    // Multiply ImGui coordinates with these to get pixel coordinates.
+	float         scale_y;
+	int           clip_min_x; // The clip rect of the draw command, in pixels [min, max).
+	int           clip_min_y; // This is clamped to the frame and band, so only paint inside of it.
+	int           clip_max_x;
+	int           clip_max_y;
+	SwPixelFormat format;
+
+	uint32_t& pixel(int x, int y) const
+	{
+		return pixels[(y - band_min_y) * stride + x];
+	}
+};
+
+enum class SwYuvFormat
+{
+	NV12, // A Y plane followed by a plane of interleaved U and V samples.
+	I420, // Separate Y, U and V planes.
+};
+
+/// A video frame with chroma subsampled by two in both directions. BT.601, limited range.
+struct SwYuvFrame
+{
+	SwYuvFormat format;
+	int         width;     // Of the Y plane.
+	int         height;    // Of the Y plane.
+	uint8_t*    y;
+	int         y_stride;  // Bytes between rows in the Y plane.
+	uint8_t*    u;         // NV12: the interleaved UV plane. I420: the U plane.
+	uint8_t*    v;         // I420: the V plane. Unused for NV12.
+	int         uv_stride; // Bytes between rows in the chroma plane(s).
+};
+
+/// A rectangle of pixels [min, max).
+struct SwRect
+{
+	int min_x, min_y, max_x, max_y;
+};
+
+/// Where to paint: a rectangle of width_pixels x height_pixels inside a possibly larger buffer,
+/// e.g. memory from SDL_LockTexture, a mapped framebuffer, or a part of an atlas.
+struct SwPixelBuffer
+{
+	uint32_t* pixels;        // The first pixel of the buffer.
+	int       width_pixels;  // Size of the painted rectangle.
+	int       height_pixels;
+	int       pitch_bytes;   // Bytes between the starts of two rows. Must be a multiple of four. 0 means width_pixels * 4.
+	int       origin_x;      // The painted rectangle starts at this column...
+	int       origin_y;      // ...and row of the buffer.
+};
+
+/// One of the pixel buffers painted by paint_imgui_multi.
+struct SwTarget
+{
+	uint32_t* pixels;
+	int       width_pixels;
+	int       height_pixels;
+	bool      downsample; // If true, the first target is box filtered down to this size instead of painting the UI here.
 };
 
 /// Optional: tweak ImGui style to make it render faster.
@@ -37,13 +123,151 @@ void bind_imgui_painting();
 /// the function scales the UI to fit the given pixel buffer.
 void paint_imgui(uint32_t* pixels, int width_pixels, int height_pixels, const SwOptions& options = {});
 
+/// Like above, but paints into a rectangle of a buffer with any row pitch, so you can paint straight
+/// into texture or framebuffer memory instead of copying a frame there afterwards.
+/// Pixels outside the rectangle are left untouched.
+void paint_imgui(const SwPixelBuffer& buffer, const SwOptions& options = {});
+
+/// Called by paint_imgui_bands when a band has been painted.
+/// band_pixels holds num_rows rows of the frame, starting at row band_y.
+using BandCallback = std::function<void(const uint32_t* band_pixels, int band_y, int num_rows)>;
+
+/// The current quality level picked by paint_imgui to stay within SwOptions::frame_budget_ms:
+///   0: Full quality.
+///   1: Anti-aliasing fringes are skipped.
+///   2: Also paints the tiles the UI covers at half resolution and upscales them. The rest of your pixels are untouched.
+int quality_level();
+
+/// Like paint_imgui, but paints the frame in horizontal bands of band_rows rows,
+/// so you only need a buffer of width_pixels * band_rows pixels instead of a full frame.
+/// Each band is cleared to clear_color, painted, and then handed to on_band.
+/// ImGui user callbacks are called once per band.
+/// The pixels are the same as paint_imgui paints: each band starts its interpolation from the top of the primitive.
+void paint_imgui_bands(
+	uint32_t*           band_pixels,
+	int                 width_pixels,
+	int                 height_pixels,
+	int                 band_rows,
+	uint32_t            clear_color,
+	const BandCallback& on_band,
+	const SwOptions&    options = {});
+
+/// Like paint_imgui, but returns a rectangle containing all pixels that may differ from
+/// the previous call to this function, e.g. for partial screen updates.
+/// You must clear pixels to the same color before each call (or not clear it at all).
+/// The first call, and any call after a size change, returns the whole frame.
+SwRect paint_imgui_damaged(uint32_t* pixels, int width_pixels, int height_pixels, const SwOptions& options = {});
+
+/// Paint the UI into several targets of different sizes, e.g. a full size frame and thumbnails of it.
+/// Each target is scaled just like in paint_imgui. The draw data is traversed once, and each primitive
+/// is painted into every target which is not to be downsampled. Up to four targets are painted per
+/// traversal; any more are painted in additional traversals, so they cost about as much as paint_imgui.
+/// The first target must be painted, else nothing is. The downsampled targets are made from it afterwards,
+/// which is cheaper than painting and looks better for small thumbnails.
+/// Draw callbacks are called once per painted target. Stats and overdraw are for the first target.
+/// SwOptions::frame_budget_ms is ignored.
+void paint_imgui_multi(const SwTarget* targets, int num_targets, const SwOptions& options = {});
+
+/// Blend the UI directly onto a video frame, e.g. a camera image.
+/// The UI is painted in small bands onto a transparent layer, which is blended into the
+/// Y and chroma planes while still in cache. Pixels without UI are left untouched.
+/// The UI is scaled to the frame size just like in paint_imgui.
+void paint_imgui_yuv(const SwYuvFrame& frame, const SwOptions& options = {});
+
+/// Like paint_imgui, but also writes a compact encoding of the frame to out_encoded,
+/// for streaming the UI to a remote viewer. Only the tiles that were painted to this frame
+/// or the previous frame are compared against the previous frame, and those that changed
+/// are run-length encoded. Decode with decode_frame.
+/// You must clear pixels to the same color before each call (or not clear it at all).
+/// Set keyframe to encode the whole frame, e.g. when a new viewer connects.
+/// The first frame, and any frame after a size change, is always a keyframe.
+void paint_imgui_encoded(
+	uint32_t*             pixels,
+	int                   width_pixels,
+	int                   height_pixels,
+	std::vector<uint8_t>* out_encoded,
+	bool                  keyframe = false,
+	const SwOptions&      options = {});
+
+/// Decode a frame written by paint_imgui_encoded into pixels,
+/// which must contain the previously decoded frame unless this is a keyframe.
+/// Returns false if the data is malformed or of another size.
+bool decode_frame(const uint8_t* data, size_t size, uint32_t* pixels, int width_pixels, int height_pixels);
+
+/// Call this from an ImGui draw callback (see ImDrawList::AddCallback) to paint directly into the pixels.
+/// Returns nullptr when not called from within one of the paint functions above,
+/// e.g. if the same callback is used with another renderer.
+const SwPaintContext* current_paint_context();
+
+/// One painted frame, as recorded by the frame telemetry.
+/// Each call to one of the paint functions above is one frame.
+struct SwFrameRecord
+{
+	uint64_t frame;          // Counts up from 1.
+	float    paint_ms;       // Wall time spent in the paint function.
+	int      num_triangles;  // Submitted by ImGui, before culling.
+	int      num_vertices;
+	int      num_draw_lists;
+};
+
+/// Paint time percentiles over the recent frames.
+struct SwFrameTimeSummary
+{
+	int   num_frames;
+	float p50_ms;
+	float p95_ms;
+	float p99_ms;
+	float max_ms;
+};
+
+/// Copy the most recent frames (at most max_frames, and at most the last 256) to out_frames, oldest first.
+/// Returns the number of frames written. Can be called from any thread, also while painting.
+int recent_frames(SwFrameRecord* out_frames, int max_frames);
+
+/// Percentiles of the paint time of the last 256 frames. Can be called from any thread.
+SwFrameTimeSummary frame_time_summary();
+
+/// How many of the recent frames took how long to paint, in fixed buckets.
+struct SwFrameTimeHistogram
+{
+	static const int kNumBuckets = 10;
+
+	int   num_frames;
+	float bucket_max_ms[kNumBuckets]; // Bucket i has the frames in (bucket_max_ms[i - 1], bucket_max_ms[i]]. The last is FLT_MAX.
+	int   counts[kNumBuckets];
+};
+
+/// Histogram of the paint time of the last 256 frames. Can be called from any thread.
+SwFrameTimeHistogram frame_time_histogram();
+
+/// Called on the painting thread when a frame took longer than threshold_ms to paint,
+/// right before the paint function returns. So you can save ImGui::GetDrawData() for analysis,
+/// or the painted pixels: after paint_imgui, paint_imgui_damaged, paint_imgui_multi and paint_imgui_encoded
+/// these are the whole frame. paint_imgui_bands has only the last band left in its buffer
+/// (save the others in on_band), and paint_imgui_yuv has the finished video frame, but not the UI by itself.
+/// Painting from within the callback is not recorded as frames.
+using SlowFrameCallback = std::function<void(const SwFrameRecord& frame)>;
+
+/// Set callback to nullptr to remove it.
+void set_slow_frame_callback(float threshold_ms, SlowFrameCallback callback);
+
 /// Free the resources allocated by bind_imgui_painting.
 void unbind_imgui_painting();
 
+/// If SwOptions::record_overdraw was set, returns how many times each pixel was painted
+/// during the last frame (width * height counters, row by row). Else returns nullptr.
+const uint16_t* overdraw_counts(int* out_width, int* out_height);
+
+/// Blend a heatmap of overdraw_counts onto pixels, e.g. right after paint_imgui.
+/// Blue means painted once, then green, yellow, orange and red for five times or more.
+void paint_overdraw_heatmap(uint32_t* pixels, int width_pixels, int height_pixels);
+void paint_overdraw_heatmap(const SwPixelBuffer& buffer);
+
 /// Show ImGui controls for rendering options if you want to.
 bool show_options(SwOptions* io_options);
 
 /// Show rendering stats in an ImGui window if you want to.
+/// Includes average overdraw and the hottest tiles if SwOptions::record_overdraw is set.
 void show_stats();
 
 } // namespace imgui_sw
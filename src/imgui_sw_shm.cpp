@@ -0,0 +1,221 @@
+// By Emil Ernerfeldt 2018
+// LICENSE:
+//   This software is dual-licensed to the public domain and under the following
+//   license: you are granted a perpetual, irrevocable license to copy, modify,
+//   publish, and distribute this file as you see fit.
+#include "imgui_sw_shm.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace imgui_sw {
+namespace {
+
+const uint32_t kRingMagic = 0x47525753; // "SWRG"
+const uint32_t kRingVersion = 1;
+const int kMaxSlots = 16;
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "The ring needs address-free 64-bit atomics");
+
+// Sequence numbers are odd while a slot is being written (a seqlock).
+// When frame N has been written to its slot, the slot sequence is 2 * N.
+struct SlotHeader
+{
+	std::atomic<uint64_t> sequence;
+	SwRect                damage;
+};
+
+// At the start of the shared memory, followed by the pixels of each slot.
+struct RingHeader
+{
+	uint32_t              magic;
+	uint32_t              version;
+	int32_t               width;
+	int32_t               height;
+	int32_t               stride;
+	int32_t               num_slots;
+	std::atomic<uint64_t> latest; // The last published frame number, or 0.
+	SlotHeader            slots[kMaxSlots];
+};
+
+size_t pixels_offset()
+{
+	const size_t alignment = 64; // Cache line
+	return (sizeof(RingHeader) + alignment - 1) / alignment * alignment;
+}
+
+size_t ring_size(int stride, int height, int num_slots)
+{
+	return pixels_offset() + static_cast<size_t>(stride) * height * num_slots * sizeof(uint32_t);
+}
+
+} // namespace
+
+struct ShmFrameRing
+{
+	std::string name;
+	bool        owner;
+	void*       memory;
+	size_t      size;
+	RingHeader* header;
+	uint64_t    frame_in_progress; // Producer only.
+
+	uint32_t* slot_pixels(uint64_t frame) const
+	{
+		const size_t slot = frame % header->num_slots;
+		const size_t slot_pixels = static_cast<size_t>(header->stride) * header->height;
+		return reinterpret_cast<uint32_t*>(static_cast<char*>(memory) + pixels_offset()) + slot * slot_pixels;
+	}
+
+	SlotHeader& slot(uint64_t frame) const
+	{
+		return header->slots[frame % header->num_slots];
+	}
+};
+
+ShmFrameRing* create_frame_ring(const char* name, int width_pixels, int height_pixels, int num_slots)
+{
+	assert(name);
+	if (width_pixels <= 0 || height_pixels <= 0 || num_slots < 2 || num_slots > kMaxSlots) { return nullptr; }
+
+	shm_unlink(name); // In case a previous producer crashed.
+	const int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+	if (fd < 0) { return nullptr; }
+
+	const int stride = width_pixels;
+	const size_t size = ring_size(stride, height_pixels, num_slots);
+	if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+		close(fd);
+		shm_unlink(name);
+		return nullptr;
+	}
+
+	void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (memory == MAP_FAILED) {
+		shm_unlink(name);
+		return nullptr;
+	}
+
+	RingHeader* header = new (memory) RingHeader;
+	header->width = width_pixels;
+	header->height = height_pixels;
+	header->stride = stride;
+	header->num_slots = num_slots;
+	header->latest.store(0);
+	for (SlotHeader& slot : header->slots) {
+		slot.sequence.store(0);
+		slot.damage = SwRect{0, 0, 0, 0};
+	}
+	header->version = kRingVersion;
+	std::atomic_thread_fence(std::memory_order_release);
+	header->magic = kRingMagic; // Last, so consumers never see a half-initialized header.
+
+	return new ShmFrameRing{name, true, memory, size, header, 0};
+}
+
+uint32_t* begin_frame(ShmFrameRing* ring)
+{
+	assert(ring && ring->owner);
+	const uint64_t frame = ring->header->latest.load(std::memory_order_relaxed) + 1;
+	ring->frame_in_progress = frame;
+
+	// Mark the slot as being written before touching any of its pixels:
+	ring->slot(frame).sequence.store(2 * frame - 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	return ring->slot_pixels(frame);
+}
+
+void publish_frame(ShmFrameRing* ring, const SwRect& damage)
+{
+	assert(ring && ring->owner && ring->frame_in_progress != 0);
+	const uint64_t frame = ring->frame_in_progress;
+	SlotHeader& slot = ring->slot(frame);
+
+	slot.damage = damage;
+	slot.sequence.store(2 * frame, std::memory_order_release);
+	ring->header->latest.store(frame, std::memory_order_release);
+	ring->frame_in_progress = 0;
+}
+
+ShmFrameRing* open_frame_ring(const char* name)
+{
+	assert(name);
+	const int fd = shm_open(name, O_RDWR, 0);
+	if (fd < 0) { return nullptr; }
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(RingHeader)) {
+		close(fd);
+		return nullptr;
+	}
+
+	const size_t size = static_cast<size_t>(info.st_size);
+	void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (memory == MAP_FAILED) { return nullptr; }
+
+	RingHeader* header = static_cast<RingHeader*>(memory);
+	const bool valid =
+		header->magic == kRingMagic &&
+		header->version == kRingVersion &&
+		header->num_slots >= 2 && header->num_slots <= kMaxSlots &&
+		size >= ring_size(header->stride, header->height, header->num_slots);
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if (!valid) {
+		munmap(memory, size);
+		return nullptr;
+	}
+
+	return new ShmFrameRing{name, false, memory, size, header, 0};
+}
+
+bool acquire_frame(ShmFrameRing* ring, uint64_t last_sequence, ShmFrame* out_frame)
+{
+	assert(ring && out_frame);
+	const uint64_t frame = ring->header->latest.load(std::memory_order_acquire);
+	if (frame == 0 || frame <= last_sequence) { return false; }
+
+	const SlotHeader& slot = ring->slot(frame);
+	if (slot.sequence.load(std::memory_order_acquire) != 2 * frame) {
+		return false; // Already being overwritten. Try again.
+	}
+
+	out_frame->pixels   = ring->slot_pixels(frame);
+	out_frame->width    = ring->header->width;
+	out_frame->height   = ring->header->height;
+	out_frame->stride   = ring->header->stride;
+	out_frame->sequence = frame;
+	out_frame->damage   = slot.damage;
+
+	// The damage could have been torn by a concurrent write:
+	return frame_still_valid(ring, *out_frame);
+}
+
+bool frame_still_valid(ShmFrameRing* ring, const ShmFrame& frame)
+{
+	assert(ring);
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return ring->slot(frame.sequence).sequence.load(std::memory_order_relaxed) == 2 * frame.sequence;
+}
+
+void destroy_frame_ring(ShmFrameRing* ring)
+{
+	if (!ring) { return; }
+	munmap(ring->memory, ring->size);
+	if (ring->owner) {
+		shm_unlink(ring->name.c_str());
+	}
+	delete ring;
+}
+
+} // namespace imgui_sw
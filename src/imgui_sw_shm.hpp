@@ -0,0 +1,76 @@
+// By Emil Ernerfeldt 2018
+// LICENSE:
+//   This software is dual-licensed to the public domain and under the following
+//   license: you are granted a perpetual, irrevocable license to copy, modify,
+//   publish, and distribute this file as you see fit.
+// WHAT:
+//   A ring of frame buffers in POSIX shared memory, for handing frames painted by
+//   imgui_sw to a compositor in another process without copying them.
+//   The producer paints directly into the shared memory, and the consumer reads it directly.
+//   Frames are published with a lock-free sequence counter per slot (a seqlock),
+//   so neither side ever waits for the other.
+// USAGE (producer):
+//   auto ring = imgui_sw::create_frame_ring("/my_ui", width, height, 3);
+//   ...
+//   uint32_t* pixels = imgui_sw::begin_frame(ring);
+//   std::fill_n(pixels, width * height, clear_color);
+//   const auto damage = imgui_sw::paint_imgui_damaged(pixels, width, height);
+//   imgui_sw::publish_frame(ring, damage);
+// USAGE (consumer): see examples/shm_consumer.cpp
+// LIMITATIONS:
+//   * Linux and macOS only (shm_open + mmap).
+#pragma once
+
+#include <cstdint>
+
+#include "imgui_sw.hpp"
+
+namespace imgui_sw {
+
+struct ShmFrameRing;
+
+/// A published frame, as seen by the consumer. The pixels point into the shared memory.
+struct ShmFrame
+{
+	const uint32_t* pixels;
+	int             width;
+	int             height;
+	int             stride;   // Number of pixels between the starts of two rows.
+	uint64_t        sequence; // 1 for the first published frame, then 2, 3, ...
+	SwRect          damage;   // Pixels that may differ from the frame before (sequence - 1).
+};
+
+// ----------------------------------------------------------------------------
+// Producer:
+
+/// Create (or replace) a shared memory ring called name (e.g. "/imgui_sw") with num_slots frames.
+/// Use at least three slots, so the consumer can read one frame while the next is being painted.
+/// Returns nullptr on failure.
+ShmFrameRing* create_frame_ring(const char* name, int width_pixels, int height_pixels, int num_slots);
+
+/// Returns the pixels of the next slot to paint into. These still hold an old frame.
+uint32_t* begin_frame(ShmFrameRing* ring);
+
+/// Publish the frame painted since begin_frame. damage is what changed since the last frame.
+void publish_frame(ShmFrameRing* ring, const SwRect& damage);
+
+// ----------------------------------------------------------------------------
+// Consumer:
+
+/// Map a ring created by another process. Returns nullptr on failure.
+ShmFrameRing* open_frame_ring(const char* name);
+
+/// Get the latest published frame, if it is newer than last_sequence.
+/// If out_frame->sequence > last_sequence + 1 you have missed frames, and should treat the whole frame as damaged.
+/// The frame may be overwritten by the producer while you read it, so call frame_still_valid when you are done.
+bool acquire_frame(ShmFrameRing* ring, uint64_t last_sequence, ShmFrame* out_frame);
+
+/// Returns false if the producer has started to overwrite the frame, meaning what you read may be torn.
+bool frame_still_valid(ShmFrameRing* ring, const ShmFrame& frame);
+
+// ----------------------------------------------------------------------------
+
+/// Unmap the ring. The producer also removes the name, so no new consumers can attach.
+void destroy_frame_ring(ShmFrameRing* ring);
+
+} // namespace imgui_sw
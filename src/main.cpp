@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include <SDL2/SDL.h>
 
 #include <emilib/imgui_helpers.hpp>
@@ -51,6 +53,36 @@ void customRendering(ImVec4 col)
 	ImGui::Dummy(ImVec2((sz+spacing)*8, (sz+spacing)*3));
 }
 
+// Paints directly into the pixels of the software renderer.
+void paintPattern(const ImDrawList*, const ImDrawCmd* cmd)
+{
+	const imgui_sw::SwPaintContext* context = imgui_sw::current_paint_context();
+	if (!context) { return; } // Not the software renderer.
+
+	const ImVec4& rect = *static_cast<const ImVec4*>(cmd->UserCallbackData);
+	const int min_x = std::max(static_cast<int>(context->scale_x * rect.x), context->clip_min_x);
+	const int min_y = std::max(static_cast<int>(context->scale_y * rect.y), context->clip_min_y);
+	const int max_x = std::min(static_cast<int>(context->scale_x * rect.z), context->clip_max_x);
+	const int max_y = std::min(static_cast<int>(context->scale_y * rect.w), context->clip_max_y);
+
+	for (int y = min_y; y < max_y; ++y) {
+		for (int x = min_x; x < max_x; ++x) {
+			const uint32_t v = static_cast<uint32_t>((x - min_x) ^ (y - min_y)) & 0xFFu;
+			context->pixel(x, y) = IM_COL32(v, 255 - v, 128, 255);
+		}
+	}
+}
+
+void customPainting()
+{
+	static ImVec4 s_rect;
+	const ImVec2 p = ImGui::GetCursorScreenPos();
+	const ImVec2 size{256.0f, 64.0f};
+	s_rect = ImVec4(p.x, p.y, p.x + size.x, p.y + size.y);
+	ImGui::GetWindowDrawList()->AddCallback(paintPattern, &s_rect);
+	ImGui::Dummy(size);
+}
+
 void showTestWindows()
 {
 	static ImVec4 s_some_color{ 0.7f, 0.8f, 0.9f, 0.5f };
@@ -61,6 +93,7 @@ void showTestWindows()
 		ImGui::ColorPicker4("some color", &s_some_color.x, ImGuiColorEditFlags_PickerHueBar);
 		ImGui::ColorPicker4("same color", &s_some_color.x, ImGuiColorEditFlags_PickerHueWheel);
 		customRendering(s_some_color);
+		customPainting();
 	}
 	ImGui::End();
 
@@ -101,10 +134,9 @@ void run_software()
 	CHECK_NOTNULL_F(renderer, "Failed to create software renderer: %s", SDL_GetError());
 
 	SDL_Texture* texture = SDL_CreateTexture(renderer,
-		SDL_PIXELFORMAT_ABGR8888, SDL_TEXTUREACCESS_STATIC, width_pixels, height_pixels);
+		SDL_PIXELFORMAT_ABGR8888, SDL_TEXTUREACCESS_STREAMING, width_pixels, height_pixels);
 	CHECK_NOTNULL_F(texture);
 
-	std::vector<uint32_t> pixel_buffer(width_pixels * height_pixels, 0);
 	std::vector<uint32_t> point_buffer(width_points * height_points, 0);
 
 	imgui_sw::bind_imgui_painting();
@@ -159,11 +191,23 @@ void run_software()
 		imgui_sdl.paint();
 		double frame_paint_time;
 
+		// Paint straight into the texture memory, instead of painting into a buffer and copying it over:
+		void* texture_pixels;
+		int pitch_bytes;
+		CHECK_EQ_F(SDL_LockTexture(texture, nullptr, &texture_pixels, &pitch_bytes), 0, "SDL_LockTexture fail: %s\n", SDL_GetError());
+		const imgui_sw::SwPixelBuffer frame{static_cast<uint32_t*>(texture_pixels), width_pixels, height_pixels, pitch_bytes, 0, 0};
+		const int stride = pitch_bytes / sizeof(uint32_t);
+
 		if (full_res) {
-			std::fill_n(pixel_buffer.data(), pixel_buffer.size(), 0x19191919u);
+			for (int y = 0; y < height_pixels; ++y) {
+				std::fill_n(frame.pixels + y * stride, width_pixels, 0x19191919u);
+			}
 			Timer paint_timer;
-			paint_imgui(pixel_buffer.data(), width_pixels, height_pixels, sw_options);
+			paint_imgui(frame, sw_options);
 			frame_paint_time = paint_timer.secs();
+			if (sw_options.record_overdraw) {
+				imgui_sw::paint_overdraw_heatmap(frame);
+			}
 		} else {
 			// Render ImGui in low resolution:
 			CHECK_LE_F(width_points, width_pixels);
@@ -171,6 +215,9 @@ void run_software()
 			Timer paint_timer;
 			paint_imgui(point_buffer.data(), width_points, height_points, sw_options);
 			frame_paint_time = paint_timer.secs();
+			if (sw_options.record_overdraw) {
+				imgui_sw::paint_overdraw_heatmap(point_buffer.data(), width_points, height_points);
+			}
 
 			// Now upsample it (TODO: a faster way).
 			Timer upsample_timer;
@@ -179,7 +226,7 @@ void run_software()
 				const auto y_pts = y_px / scale;
 				for (int x_px = 0; x_px < width_pixels; ++x_px) {
 					const auto x_pts = x_px / scale;
-					pixel_buffer[y_px * width_pixels + x_px] = point_buffer[y_pts * width_points + x_pts];
+					frame.pixels[y_px * stride + x_px] = point_buffer[y_pts * width_points + x_pts];
 				}
 			}
 			upsample_time = upsample_timer.secs();
@@ -187,7 +234,7 @@ void run_software()
 
 		paint_time = 0.95 * paint_time + 0.05 * frame_paint_time;
 
-		SDL_UpdateTexture(texture, nullptr, pixel_buffer.data(), width_pixels * sizeof(Uint32));
+		SDL_UnlockTexture(texture);
 		// SDL_RenderClear(renderer);
 		SDL_RenderCopy(renderer, texture, nullptr, nullptr);
 		SDL_RenderPresent(renderer);